@@ -0,0 +1,28 @@
+/**
+ * @file
+ * @brief System clock profiles, shared by both nodes.
+ */
+
+#include "hal.h"
+#include "clock.h"
+
+void clock_init(void)
+{
+    // Wait states have to be in place before MCLK goes above 8 MHz.
+    FRCTL0 = FRCTLPW | CLOCK_FRAM_WAITS;
+
+    __bis_SR_register(SCG0);                // Hold the FLL while it's reconfigured
+    CSCTL3 = SELREF__REFOCLK;               // FLL reference is REFO
+    CSCTL0 = 0;                             // Start the DCO tap and modulation from the bottom
+    CSCTL1 = CLOCK_DCORSEL;
+    CSCTL2 = FLLD_0 | CLOCK_FLLN;           // DCOCLKDIV = 32768 * (FLLN + 1)
+    __delay_cycles(3);
+    __bic_SR_register(SCG0);
+
+    while (CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1))
+    {
+        // Wait for the FLL to lock
+    }
+
+    CSCTL4 = SELMS__DCOCLKDIV | SELA__REFOCLK;
+}
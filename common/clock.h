@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief System clock profiles, shared by both nodes.
+ *
+ * CLOCK_MHZ picks the profile at compile time: 1, 8, 16 or 24 MHz (the FR2310
+ * tops out at 16). Set it in the project's predefined symbols, e.g.
+ * CLOCK_MHZ=16. clock_init() locks the FLL to REFO at that rate and sets the
+ * FRAM wait states. MCLK and SMCLK both run from DCOCLKDIV and ACLK stays on
+ * the 32768 Hz REFO, so ACLK periods don't change between profiles.
+ *
+ * Every SMCLK-derived divider or reload value should come from the macros
+ * below rather than being written for one clock rate.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#ifndef CLOCK_MHZ
+#define CLOCK_MHZ 1
+#endif
+
+/** REFO, the FLL reference and ACLK */
+#define CLOCK_ACLK_HZ 32768UL
+
+// DCORSEL range, FLL multiplier and FRAM wait states for each profile. DCOCLKDIV = 32768 * (FLLN + 1).
+// The eUSCI_A UART settings are for CLOCK_UART_BAUD at that exact SMCLK: UCAxBRW, and UCAxMCTLW as
+// UCBRSx << 8 | UCBRFx << 4 | UCOS16, each with under 1 % bit error (2.6 % at 1 MHz, hence the lower rate).
+#if CLOCK_MHZ == 1
+#define CLOCK_DCORSEL DCORSEL_0
+#define CLOCK_FLLN 30
+#define CLOCK_FRAM_WAITS NWAITS_0
+#define CLOCK_UART_BAUD 57600UL
+#define CLOCK_UART_BRW 1
+#define CLOCK_UART_MCTLW 0xAD11
+#elif CLOCK_MHZ == 8
+#define CLOCK_DCORSEL DCORSEL_3
+#define CLOCK_FLLN 243
+#define CLOCK_FRAM_WAITS NWAITS_0
+#define CLOCK_UART_BAUD 115200UL
+#define CLOCK_UART_BRW 4
+#define CLOCK_UART_MCTLW 0x2951
+#elif CLOCK_MHZ == 16
+#define CLOCK_DCORSEL DCORSEL_5
+#define CLOCK_FLLN 487
+#define CLOCK_FRAM_WAITS NWAITS_1      // FRAM runs at most 8 MHz without wait states
+#define CLOCK_UART_BAUD 115200UL
+#define CLOCK_UART_BRW 8
+#define CLOCK_UART_MCTLW 0x7BA1
+#elif CLOCK_MHZ == 24
+#define CLOCK_DCORSEL DCORSEL_7
+#define CLOCK_FLLN 731
+#define CLOCK_FRAM_WAITS NWAITS_2
+#define CLOCK_UART_BAUD 115200UL
+#define CLOCK_UART_BRW 13
+#define CLOCK_UART_MCTLW 0x8401
+#else
+#error "CLOCK_MHZ must be 1, 8, 16 or 24"
+#endif
+
+#if CLOCK_MHZ > 16 && defined(__MSP430FR2310__)
+#error "The FR2310 runs at most 16 MHz"
+#endif
+
+/** MCLK and SMCLK */
+#define CLOCK_SMCLK_HZ (CLOCK_ACLK_HZ * (CLOCK_FLLN + 1))
+#define CLOCK_MCLK_HZ CLOCK_SMCLK_HZ
+
+/** Integer divide rounding up, usable in #if */
+#define CLOCK_DIV_CEIL(a, b) (((a) + (b) - 1) / (b))
+
+/** Ticks of a hz clock in us microseconds, rounded up. Good up to 40 MHz * 10 ms. */
+#define CLOCK_TICKS_US(hz, us) CLOCK_DIV_CEIL((hz) / 100 * (us), 10000)
+
+/** MCLK cycles in ns nanoseconds, rounded up, for __delay_cycles() */
+#define CLOCK_CYCLES_NS(ns) CLOCK_DIV_CEIL(CLOCK_MCLK_HZ / 1000 * (ns), 1000000)
+
+/** UCBxBRW for an I2C master at rate_hz (100000, 400000 or 1000000), rounded to the next slower rate */
+#define CLOCK_I2C_PRESCALER(rate_hz) CLOCK_DIV_CEIL(CLOCK_SMCLK_HZ, rate_hz)
+
+/** Smallest UCBxBRW the eUSCI_B is specified for as an I2C master */
+#define CLOCK_I2C_MIN_PRESCALER 4
+
+/** SMCLK divider that keeps the ADC clock within its 5 MHz limit */
+#define CLOCK_ADC_DIVIDER CLOCK_DIV_CEIL(CLOCK_SMCLK_HZ, 5000000UL)
+
+/**
+ * Set the FRAM wait states and lock the FLL for the CLOCK_MHZ profile.
+ * Call first thing in main(), after stopping the watchdog.
+ */
+void clock_init(void);
+
+#endif // CLOCK_H
@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief Small versioned, checksummed records kept in FRAM across resets.
+ */
+
+#include "hal.h"
+#include "fram_record.h"
+#include "status_frame.h"
+
+#define COPY_SIZE(size) ((size) + FRAM_RECORD_OVERHEAD)
+
+static uint16_t get_u16(const uint8_t *in)
+{
+    return in[0] | ((uint16_t)in[1] << 8);
+}
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static uint8_t crc_step(uint8_t crc, uint8_t byte)
+{
+    // status_frame_crc8() of one byte starts from 0, so feeding it crc ^ byte carries a running CRC on.
+    uint8_t in = crc ^ byte;
+    return status_frame_crc8(&in, 1);
+}
+
+void fram_record_unlock(void)
+{
+    SYSCFG0 = FRWPPW | DFWP;
+}
+
+void fram_record_lock(void)
+{
+    SYSCFG0 = FRWPPW | DFWP | PFWP;
+}
+
+static bool valid(const uint8_t *copy, uint16_t version, uint8_t size)
+{
+    return get_u16(copy) == version && status_frame_crc8(copy, COPY_SIZE(size) - 1) == copy[COPY_SIZE(size) - 1];
+}
+
+// Index of the newest valid copy, or -1 if there is none.
+static int8_t newest(const uint8_t *storage, uint16_t version, uint8_t size)
+{
+    const uint8_t *second = storage + COPY_SIZE(size);
+    bool first_valid = valid(storage, version, size);
+    bool second_valid = valid(second, version, size);
+
+    if (first_valid && second_valid)
+    {
+        // Sequence numbers wrap, so the newer one is the one a small step ahead.
+        return (int16_t)(get_u16(second + 2) - get_u16(storage + 2)) > 0 ? 1 : 0;
+    }
+    return first_valid ? 0 : (second_valid ? 1 : -1);
+}
+
+bool fram_record_load(const uint8_t *storage, uint16_t version, void *payload, uint8_t size)
+{
+    int8_t copy = newest(storage, version, size);
+    if (copy < 0)
+    {
+        return false;
+    }
+
+    const uint8_t *in = storage + copy * COPY_SIZE(size) + 4;
+    uint8_t *out = payload;
+    uint8_t i;
+    for (i = 0; i < size; i++)
+    {
+        out[i] = in[i];
+    }
+    return true;
+}
+
+void fram_record_save(uint8_t *storage, uint16_t version, const void *payload, uint8_t size)
+{
+    const uint8_t *in = payload;
+    int8_t current = newest(storage, version, size);
+    uint16_t sequence = 0;
+
+    if (current >= 0)
+    {
+        const uint8_t *copy = storage + current * COPY_SIZE(size);
+        uint8_t i = 0;
+        while (i < size && copy[4 + i] == in[i])
+        {
+            i++;
+        }
+        if (i == size)
+        {
+            return;     // Already stored, don't rewrite
+        }
+        sequence = get_u16(copy + 2) + 1;
+    }
+
+    // The CRC covers the real version, which only goes into the copy at the very end.
+    uint8_t header[4];
+    put_u16(header, version);
+    put_u16(header + 2, sequence);
+    uint8_t crc = status_frame_crc8(header, sizeof(header));
+
+    // Overwrite the other copy, so the current one survives a reset in the middle of this. Version 0 never
+    // loads, so the copy stays invalid until the last write, whatever its old CRC happens to match.
+    uint8_t *copy = storage + (current == 0 ? 1 : 0) * COPY_SIZE(size);
+    fram_record_unlock();
+    put_u16(copy, 0);
+    put_u16(copy + 2, sequence);
+    uint8_t i;
+    for (i = 0; i < size; i++)
+    {
+        copy[4 + i] = in[i];
+        crc = crc_step(crc, in[i]);
+    }
+    copy[COPY_SIZE(size) - 1] = crc;
+    put_u16(copy, version);
+    fram_record_lock();
+}
@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief Small versioned, checksummed records kept in FRAM across resets.
+ *
+ * A record is stored twice. Each copy is
+ *
+ *     [version] [sequence] [payload]... [CRC-8]
+ *
+ * with 16-bit version and sequence and the status frame CRC over every byte
+ * before it. A save goes into the older copy with the next sequence number.
+ * It sets that copy's version to 0 first and writes the real version last,
+ * after the CRC, so a reset part way through leaves the copy invalid, even
+ * where a torn payload would happen to match the old CRC, and the other copy
+ * intact. A load takes the newer valid copy.
+ * Saving an unchanged payload writes nothing.
+ *
+ * The storage is a PERSISTENT byte array of FRAM_RECORD_STORAGE(payload size)
+ * bytes, declared by the owner:
+ *
+ *     #pragma PERSISTENT(config_storage)
+ *     static uint8_t config_storage[FRAM_RECORD_STORAGE(sizeof(struct config))] = {0};
+ */
+
+#ifndef FRAM_RECORD_H
+#define FRAM_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Version, sequence and CRC around each copy */
+#define FRAM_RECORD_OVERHEAD 5
+
+/** Storage for both copies of a payload of the given size, at most 250 bytes */
+#define FRAM_RECORD_STORAGE(size) (2 * ((size) + FRAM_RECORD_OVERHEAD))
+
+/**
+ * Read the newest valid copy.
+ *
+ * @param: storage Both copies, FRAM_RECORD_STORAGE(size) bytes.
+ * @param: version Layout version the caller expects, not 0, which zeroed storage would pass as. Copies with
+ *         another version are ignored.
+ * @param: payload Output, only written if a valid copy was found.
+ * @param: size Payload size in bytes.
+ *
+ * @return: false if neither copy is valid, e.g. on first boot or after the layout changed.
+ */
+bool fram_record_load(const uint8_t *storage, uint16_t version, void *payload, uint8_t size);
+
+/**
+ * Store a payload over the older copy, unless the newest copy already holds it.
+ *
+ * @param: storage Both copies, FRAM_RECORD_STORAGE(size) bytes, in program FRAM.
+ * @param: version Layout version to store.
+ * @param: payload Bytes to store.
+ * @param: size Payload size in bytes.
+ */
+void fram_record_save(uint8_t *storage, uint16_t version, const void *payload, uint8_t size);
+
+/**
+ * Lift the write protection on program FRAM, where PERSISTENT data lives, for
+ * writing to it directly. fram_record_save() does this itself.
+ */
+void fram_record_unlock(void);
+
+/**
+ * Write protect program FRAM again.
+ */
+void fram_record_lock(void);
+
+#endif // FRAM_RECORD_H
@@ -0,0 +1,23 @@
+/**
+ * @file
+ * @brief Entry points every firmware provides.
+ *
+ * main() on the target is just app_init() followed by app_poll() forever. The
+ * simulator calls them itself, so it can step peripherals and interrupts
+ * between passes of the main loop.
+ */
+
+#ifndef APP_H
+#define APP_H
+
+/**
+ * Configure the clocks and peripherals and enable interrupts.
+ */
+void app_init(void);
+
+/**
+ * Run one pass of the main loop: handle pending work, then sleep if there is none.
+ */
+void app_poll(void);
+
+#endif // APP_H
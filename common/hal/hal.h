@@ -0,0 +1,41 @@
+/**
+ * @file
+ * @brief Hardware abstraction, the one header firmware includes instead of <msp430.h>.
+ *
+ * Firmware keeps talking to the peripherals through their registers, so on
+ * the target this is <msp430.h> plus HAL_ISR and costs nothing. Building with
+ * HAL_SIM defined swaps in the Linux simulation backend (hal_sim.h), where
+ * the same registers are plain variables backed by models of the GPIO ports,
+ * Timer_B, the ADC and eUSCI_B I2C, and ISRs are ordinary functions the
+ * simulator calls.
+ *
+ * Each firmware also provides the entry points in app.h, so the simulator can
+ * run its main loop one pass at a time.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef HAL_SIM
+
+#include "hal_sim.h"
+
+#else
+
+#include <msp430.h>
+
+#define HAL_PRAGMA(x) _Pragma(#x)
+
+/**
+ * Define an interrupt service routine.
+ *
+ *     HAL_ISR(TIMER0_B0_VECTOR, ISR_TB0_Tick)
+ *     {
+ *         ...
+ *     }
+ */
+#define HAL_ISR(v, name) HAL_PRAGMA(vector = v) __interrupt void name(void)
+
+#endif // HAL_SIM
+
+#endif // HAL_H
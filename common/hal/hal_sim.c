@@ -0,0 +1,687 @@
+/**
+ * @file
+ * @brief Linux simulation backend for hal.h.
+ */
+
+#ifdef HAL_SIM
+
+#include <stddef.h>
+#include "hal.h"
+#include "clock.h"
+
+//---------------- Registers ----------------
+
+#define PORT_REGISTERS(n) \
+    volatile uint8_t P##n##OUT, P##n##IN, P##n##DIR, P##n##SEL0, P##n##SEL1, P##n##REN, P##n##IE, P##n##IES, P##n##IFG;
+PORT_REGISTERS(1)
+PORT_REGISTERS(2)
+PORT_REGISTERS(3)
+PORT_REGISTERS(4)
+PORT_REGISTERS(5)
+PORT_REGISTERS(6)
+
+#define TIMER_REGISTERS(n) \
+    volatile uint16_t TB##n##CTL, TB##n##R, TB##n##CCR0, TB##n##CCR1, TB##n##CCR2, \
+                      TB##n##CCTL0, TB##n##CCTL1, TB##n##CCTL2, TB##n##IV;
+TIMER_REGISTERS(0)
+TIMER_REGISTERS(1)
+TIMER_REGISTERS(2)
+TIMER_REGISTERS(3)
+
+#define EUSCI_B_REGISTERS(n) \
+    volatile uint16_t UCB##n##CTLW0 = UCSWRST, UCB##n##CTLW1, UCB##n##BRW, UCB##n##STATW, UCB##n##I2COA0, \
+                      UCB##n##I2CSA, UCB##n##IE, UCB##n##IFG, UCB##n##IV, UCB##n##TXBUF = TXBUF_EMPTY, UCB##n##RXBUF;
+#define TXBUF_EMPTY 0xFFFF  // Never written by firmware, which only sends bytes
+EUSCI_B_REGISTERS(0)
+EUSCI_B_REGISTERS(1)
+volatile uint16_t UCA1CTLW0 = UCSWRST, UCA1BRW, UCA1MCTLW, UCA1IE, UCA1IFG, UCA1IV, UCA1TXBUF = TXBUF_EMPTY;
+
+volatile uint16_t ADCCTL0, ADCCTL1, ADCCTL2, ADCMCTL0, ADCMEM0, ADCIE, ADCIFG, ADCIV;
+volatile uint16_t WDTCTL, PM5CTL0 = LOCKLPM5, FRCTL0, SYSCFG0 = DFWP | PFWP;
+volatile uint16_t SYSRSTIV = SYSRSTIV_BOR;  // Every load is a power-up. Reads don't pop it like the real one does.
+volatile uint16_t CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL5, CSCTL6, CSCTL7, CSCTL8;
+
+//---------------- Core ----------------
+
+static void (*isrs[HAL_SIM_VECTOR_COUNT])(void);
+static bool interrupts_enabled = false;
+static bool in_isr = false;
+static uint16_t sleep_bits = 0;
+static uint32_t ticks = 0;
+static void (*step_hook)(void);
+static void (*delay_hook)(void);
+
+void hal_sim_register_isr(enum hal_sim_vector vector, void (*isr)(void))
+{
+    isrs[vector] = isr;
+}
+
+void __enable_interrupt(void)
+{
+    interrupts_enabled = true;
+}
+
+void __disable_interrupt(void)
+{
+    interrupts_enabled = false;
+}
+
+uint16_t __get_interrupt_state(void)
+{
+    return interrupts_enabled ? GIE : 0;
+}
+
+void __set_interrupt_state(uint16_t state)
+{
+    interrupts_enabled = (state & GIE) != 0;
+}
+
+void __bis_SR_register(uint16_t bits)
+{
+    // Returns straight away; hal_sim_sleeping() tells the simulator to step until an ISR clears the bits.
+    if (bits & GIE)
+    {
+        interrupts_enabled = true;
+    }
+    sleep_bits |= bits & LPM4_bits;
+}
+
+void __bic_SR_register(uint16_t bits)
+{
+    if (bits & GIE)
+    {
+        interrupts_enabled = false;
+    }
+}
+
+void __bic_SR_register_on_exit(uint16_t bits)
+{
+    sleep_bits &= ~bits;
+}
+
+void __delay_cycles(unsigned long cycles)
+{
+    (void)cycles;
+    if (delay_hook)
+    {
+        delay_hook();
+    }
+}
+
+void __no_operation(void)
+{
+}
+
+bool hal_sim_sleeping(void)
+{
+    // Only CPUOFF halts the CPU; an ISR that clears LPM0_bits from LPM3 leaves SCG0/SCG1 set but still wakes it.
+    return (sleep_bits & CPUOFF) != 0;
+}
+
+uint32_t hal_sim_ticks(void)
+{
+    return ticks;
+}
+
+void hal_sim_set_step_hook(void (*hook)(void))
+{
+    step_hook = hook;
+}
+
+void hal_sim_set_delay_hook(void (*hook)(void))
+{
+    delay_hook = hook;
+}
+
+static void call_isr(enum hal_sim_vector vector)
+{
+    if (isrs[vector])
+    {
+        in_isr = true;
+        interrupts_enabled = false;     // Cleared on entry, as on the target
+        isrs[vector]();
+        interrupts_enabled = true;
+        in_isr = false;
+    }
+}
+
+//---------------- GPIO ----------------
+
+struct port
+{
+    volatile uint8_t *in;
+    volatile uint8_t *ie;
+    volatile uint8_t *ies;
+    volatile uint8_t *ifg;
+    enum hal_sim_vector vector;
+    uint8_t last_in;
+};
+
+static struct port ports[] = {
+    {&P1IN, &P1IE, &P1IES, &P1IFG, PORT1_VECTOR, 0},
+    {&P2IN, &P2IE, &P2IES, &P2IFG, PORT2_VECTOR, 0},
+    {&P3IN, &P3IE, &P3IES, &P3IFG, PORT3_VECTOR, 0},
+    {&P4IN, &P4IE, &P4IES, &P4IFG, PORT4_VECTOR, 0},
+};
+#define PORT_COUNT (sizeof(ports) / sizeof(ports[0]))
+
+static void update_ports(void)
+{
+    unsigned int i;
+    for (i = 0; i < PORT_COUNT; i++)
+    {
+        struct port *port = &ports[i];
+        uint8_t in = *port->in;
+        uint8_t rising = in & ~port->last_in;
+        uint8_t falling = ~in & port->last_in;
+        *port->ifg |= (rising & ~*port->ies) | (falling & *port->ies);
+        port->last_in = in;
+    }
+}
+
+static bool service_ports(void)
+{
+    unsigned int i;
+    for (i = 0; i < PORT_COUNT; i++)
+    {
+        if (*ports[i].ifg & *ports[i].ie)
+        {
+            call_isr(ports[i].vector);
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------- ADC ----------------
+
+static uint16_t adc_inputs[16];
+static uint8_t adc_channel = 0;     // Next input in a sequence
+static bool adc_sequencing = false;
+
+void hal_sim_adc_set_input(uint8_t input, uint16_t code)
+{
+    adc_inputs[input & ADCINCH] = code;
+}
+
+static void adc_trigger(void)
+{
+    if (!(ADCCTL0 & ADCENC) || !(ADCCTL0 & ADCON))
+    {
+        adc_sequencing = false;
+        return;
+    }
+
+    uint8_t first = ADCMCTL0 & ADCINCH;
+    uint16_t mode = ADCCTL1 & ADCCONSEQ;
+    if (!adc_sequencing || mode == ADCCONSEQ_0 || mode == ADCCONSEQ_2)
+    {
+        adc_channel = first;
+        adc_sequencing = true;
+    }
+
+    if (ADCIFG & ADCIFG0)
+    {
+        ADCIFG |= ADCOVIFG;     // The last result was never read
+    }
+    ADCMEM0 = adc_inputs[adc_channel];
+    ADCIFG |= ADCIFG0;
+
+    // Sequences count down to A0 and start over from ADCINCHx.
+    adc_channel = adc_channel ? adc_channel - 1 : first;
+}
+
+static bool service_adc(void)
+{
+    if (ADCIFG & ADCIE & ADCIFG0)
+    {
+        ADCIFG &= ~ADCIFG0;     // Reading ADCMEM0 clears it on the target
+        call_isr(ADC_VECTOR);
+        return true;
+    }
+    return false;
+}
+
+//---------------- Timer_B ----------------
+
+struct timer
+{
+    volatile uint16_t *ctl;
+    volatile uint16_t *r;
+    volatile uint16_t *ccr[3];
+    volatile uint16_t *cctl[3];
+    volatile uint16_t *iv;
+    enum hal_sim_vector vector0;
+    enum hal_sim_vector vector1;
+    uint8_t divider_count;
+};
+
+static struct timer timers[] = {
+    {&TB0CTL, &TB0R, {&TB0CCR0, &TB0CCR1, &TB0CCR2}, {&TB0CCTL0, &TB0CCTL1, &TB0CCTL2}, &TB0IV,
+     TIMER0_B0_VECTOR, TIMER0_B1_VECTOR, 0},
+    {&TB1CTL, &TB1R, {&TB1CCR0, &TB1CCR1, &TB1CCR2}, {&TB1CCTL0, &TB1CCTL1, &TB1CCTL2}, &TB1IV,
+     TIMER1_B0_VECTOR, TIMER1_B1_VECTOR, 0},
+    {&TB2CTL, &TB2R, {&TB2CCR0, &TB2CCR1, &TB2CCR2}, {&TB2CCTL0, &TB2CCTL1, &TB2CCTL2}, &TB2IV,
+     TIMER2_B0_VECTOR, TIMER2_B1_VECTOR, 0},
+    {&TB3CTL, &TB3R, {&TB3CCR0, &TB3CCR1, &TB3CCR2}, {&TB3CCTL0, &TB3CCTL1, &TB3CCTL2}, &TB3IV,
+     TIMER3_B0_VECTOR, TIMER3_B1_VECTOR, 0},
+};
+#define TIMER_COUNT (sizeof(timers) / sizeof(timers[0]))
+#define ADC_TRIGGER_TIMER 2     // TB2.1B, ADCSHS_3
+
+static bool service_interrupts(void);
+
+// One count of the timer's input clock.
+static void timer_clock(struct timer *timer, unsigned int index)
+{
+    uint16_t ctl = *timer->ctl;
+    uint16_t mode = ctl & MC;
+    if (mode == MC__STOP)
+    {
+        return;
+    }
+
+    uint8_t divider = 1 << ((ctl & ID) >> 6);
+    if (++timer->divider_count < divider)
+    {
+        return;
+    }
+    timer->divider_count = 0;
+
+    uint16_t r = *timer->r;
+    if (mode == MC__UP && r >= *timer->ccr[0])
+    {
+        r = 0;
+        *timer->ctl |= TBIFG;
+    }
+    else
+    {
+        r++;
+        if (r == 0)
+        {
+            *timer->ctl |= TBIFG;
+        }
+    }
+    *timer->r = r;
+
+    int n;
+    for (n = 0; n < 3; n++)
+    {
+        if (r == *timer->ccr[n])
+        {
+            *timer->cctl[n] |= CCIFG;
+        }
+    }
+
+    // Reset/set output: TB2.1 rises when the count reaches CCR0, which is what starts a triggered conversion.
+    if (index == ADC_TRIGGER_TIMER && r == *timer->ccr[0] && (*timer->cctl[1] & OUTMOD) == OUTMOD_7
+        && (ADCCTL1 & ADCSHS) == ADCSHS_3)
+    {
+        adc_trigger();
+    }
+
+    service_interrupts();
+}
+
+static bool service_timers(void)
+{
+    unsigned int i;
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        struct timer *timer = &timers[i];
+        if ((*timer->cctl[0] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        {
+            *timer->cctl[0] &= ~CCIFG;  // CCR0 has its own vector and clears its flag on entry
+            call_isr(timer->vector0);
+            return true;
+        }
+
+        uint16_t iv = 0;
+        if ((*timer->cctl[1] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        {
+            *timer->cctl[1] &= ~CCIFG;
+            iv = 0x02;
+        }
+        else if ((*timer->cctl[2] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        {
+            *timer->cctl[2] &= ~CCIFG;
+            iv = 0x04;
+        }
+        else if ((*timer->ctl & (TBIE | TBIFG)) == (TBIE | TBIFG))
+        {
+            *timer->ctl &= ~TBIFG;
+            iv = 0x0E;
+        }
+        if (iv)
+        {
+            *timer->iv = iv;        // Reading TBxIV clears the flag on the target, so it is cleared here instead
+            call_isr(timer->vector1);
+            *timer->iv = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------- eUSCI_B I2C ----------------
+
+enum i2c_master_state
+{
+    MASTER_IDLE,
+    MASTER_TRANSMIT,
+    MASTER_NACKED
+};
+
+struct i2c
+{
+    volatile uint16_t *ctlw0;
+    volatile uint16_t *statw;
+    volatile uint16_t *i2coa0;
+    volatile uint16_t *i2csa;
+    volatile uint16_t *ie;
+    volatile uint16_t *ifg;
+    volatile uint16_t *iv;
+    volatile uint16_t *txbuf;
+    volatile uint16_t *rxbuf;
+    enum hal_sim_vector vector;
+    const struct hal_sim_i2c_device *device;
+    enum i2c_master_state state;
+};
+
+static struct i2c buses[] = {
+    {&UCB0CTLW0, &UCB0STATW, &UCB0I2COA0, &UCB0I2CSA, &UCB0IE, &UCB0IFG, &UCB0IV, &UCB0TXBUF, &UCB0RXBUF,
+     USCI_B0_VECTOR, NULL, MASTER_IDLE},
+    {&UCB1CTLW0, &UCB1STATW, &UCB1I2COA0, &UCB1I2CSA, &UCB1IE, &UCB1IFG, &UCB1IV, &UCB1TXBUF, &UCB1RXBUF,
+     USCI_B1_VECTOR, NULL, MASTER_IDLE},
+};
+#define BUS_COUNT (sizeof(buses) / sizeof(buses[0]))
+
+// UCBxIV value for each flag, highest priority first
+static const struct
+{
+    uint16_t flag;
+    uint16_t iv;
+} i2c_sources[] = {
+    {UCALIFG, 0x02},
+    {UCNACKIFG, 0x04},
+    {UCSTTIFG, 0x06},
+    {UCSTPIFG, 0x08},
+    {UCRXIFG0, 0x16},
+    {UCTXIFG0, 0x18},
+    {UCCLTOIFG, 0x1C},
+};
+#define I2C_SOURCE_COUNT (sizeof(i2c_sources) / sizeof(i2c_sources[0]))
+
+void hal_sim_i2c_attach(uint8_t bus, const struct hal_sim_i2c_device *device)
+{
+    buses[bus].device = device;
+}
+
+// One bus event per step, close to a byte time at 100 - 400 kHz.
+static void i2c_master_clock(struct i2c *bus)
+{
+    uint16_t ctlw0 = *bus->ctlw0;
+    if ((ctlw0 & UCSWRST) || !(ctlw0 & UCMST))
+    {
+        bus->state = MASTER_IDLE;
+        return;
+    }
+
+    switch (bus->state)
+    {
+        case MASTER_IDLE:
+            if (ctlw0 & UCTXSTT)
+            {
+                const struct hal_sim_i2c_device *device = bus->device;
+                *bus->ctlw0 &= ~UCTXSTT;
+                *bus->txbuf = TXBUF_EMPTY;
+                *bus->statw |= UCBBUSY;
+                if (device && device->start(device->context, *bus->i2csa & 0x7F))
+                {
+                    bus->state = MASTER_TRANSMIT;
+                    *bus->ifg |= UCTXIFG0;
+                }
+                else
+                {
+                    bus->state = MASTER_NACKED;
+                    *bus->ifg |= UCNACKIFG;
+                }
+            }
+            break;
+
+        case MASTER_TRANSMIT:
+            if (*bus->txbuf != TXBUF_EMPTY)
+            {
+                bus->device->byte(bus->device->context, (uint8_t)*bus->txbuf);
+                *bus->txbuf = TXBUF_EMPTY;
+                *bus->ifg |= UCTXIFG0;
+            }
+            else if (ctlw0 & UCTXSTP)
+            {
+                bus->device->stop(bus->device->context);
+                *bus->ctlw0 &= ~UCTXSTP;
+                *bus->statw &= ~UCBBUSY;
+                *bus->ifg |= UCSTPIFG;
+                bus->state = MASTER_IDLE;
+            }
+            break;
+
+        case MASTER_NACKED:
+            if (ctlw0 & UCTXSTP)
+            {
+                *bus->ctlw0 &= ~UCTXSTP;
+                *bus->statw &= ~UCBBUSY;
+                *bus->ifg |= UCSTPIFG;
+                bus->state = MASTER_IDLE;
+            }
+            break;
+    }
+}
+
+static bool service_i2c(void)
+{
+    unsigned int i;
+    for (i = 0; i < BUS_COUNT; i++)
+    {
+        struct i2c *bus = &buses[i];
+        unsigned int s;
+        for (s = 0; s < I2C_SOURCE_COUNT; s++)
+        {
+            if (*bus->ifg & *bus->ie & i2c_sources[s].flag)
+            {
+                *bus->ifg &= ~i2c_sources[s].flag;  // Reading UCBxIV clears the highest flag on the target
+                *bus->iv = i2c_sources[s].iv;
+                call_isr(bus->vector);
+                *bus->iv = 0;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool hal_sim_i2c_slave_start(uint8_t index, uint8_t address)
+{
+    struct i2c *bus = &buses[index];
+    uint16_t own = *bus->i2coa0;
+
+    if ((*bus->ctlw0 & (UCSWRST | UCMST)) || !(own & UCOAEN))
+    {
+        return false;
+    }
+
+    bool general_call = address == 0x00;
+    if (general_call ? !(own & UCGCEN) : address != (own & 0x7F))
+    {
+        return false;
+    }
+
+    *bus->statw = (*bus->statw & ~UCGC) | (general_call ? UCGC : 0) | UCBBUSY;
+    *bus->ifg |= UCSTTIFG;
+    service_interrupts();
+    return true;
+}
+
+void hal_sim_i2c_slave_byte(uint8_t index, uint8_t data)
+{
+    struct i2c *bus = &buses[index];
+
+    *bus->rxbuf = data;
+    *bus->ifg |= UCRXIFG0;
+    service_interrupts();
+}
+
+void hal_sim_i2c_slave_stop(uint8_t index)
+{
+    struct i2c *bus = &buses[index];
+
+    *bus->statw &= ~UCBBUSY;
+    *bus->ifg |= UCSTPIFG;
+    service_interrupts();
+}
+
+//---------------- eUSCI_A1 UART ----------------
+
+static void (*uart_tx_hook)(uint8_t data);
+static uint32_t uart_shift_cycles = 0;  // SMCLK cycles left on the byte being shifted out, 0 when idle
+static uint8_t uart_shift;
+
+void hal_sim_uart_set_tx_hook(void (*hook)(uint8_t data))
+{
+    uart_tx_hook = hook;
+}
+
+// Start, 8 data and stop bits at the divider's rate. UCBRSx only moves bit edges about, so it's left out.
+static uint32_t uart_byte_cycles(void)
+{
+    uint32_t bit = (UCA1MCTLW & UCOS16) ? 16UL * UCA1BRW + ((UCA1MCTLW >> 4) & 0x0F) : UCA1BRW;
+    return 10 * (bit ? bit : 1);
+}
+
+static void uart_clock(uint32_t cycles)
+{
+    if (UCA1CTLW0 & UCSWRST)
+    {
+        uart_shift_cycles = 0;
+        UCA1TXBUF = TXBUF_EMPTY;
+        return;
+    }
+
+    while (cycles)
+    {
+        if (!uart_shift_cycles)
+        {
+            if (UCA1TXBUF == TXBUF_EMPTY)
+            {
+                return;
+            }
+            uart_shift = (uint8_t)UCA1TXBUF;
+            UCA1TXBUF = TXBUF_EMPTY;
+            UCA1IFG |= UCTXIFG;         // TXBUF is free again as soon as the shift register takes it
+            uart_shift_cycles = uart_byte_cycles();
+        }
+
+        uint32_t elapsed = cycles < uart_shift_cycles ? cycles : uart_shift_cycles;
+        uart_shift_cycles -= elapsed;
+        cycles -= elapsed;
+        if (!uart_shift_cycles && uart_tx_hook)
+        {
+            uart_tx_hook(uart_shift);
+        }
+    }
+}
+
+static bool service_uart(void)
+{
+    if (UCA1IFG & UCA1IE & UCTXIFG)
+    {
+        UCA1IFG &= ~UCTXIFG;    // Reading UCA1IV clears it on the target
+        UCA1IV = 0x04;
+        call_isr(USCI_A1_VECTOR);
+        UCA1IV = 0;
+        return true;
+    }
+    return false;
+}
+
+//---------------- Stepping ----------------
+
+// Take every pending, enabled interrupt, one at a time as the target would.
+static bool service_interrupts(void)
+{
+    if (!interrupts_enabled || in_isr)
+    {
+        return false;
+    }
+
+    bool serviced = false;
+    int limit = 64;     // An ISR that never clears its flag would otherwise spin forever
+    while (limit-- > 0 && (service_timers() || service_adc() || service_i2c() || service_uart() || service_ports()))
+    {
+        serviced = true;
+    }
+    return serviced;
+}
+
+static bool uses_clock(const struct timer *timer, uint16_t source)
+{
+    return (*timer->ctl & TBSSEL) == source;
+}
+
+void hal_sim_step(void)
+{
+    static uint32_t smclk_fraction = 0;
+    unsigned int i;
+
+    if (step_hook)
+    {
+        step_hook();
+    }
+    update_ports();
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        if (*timers[i].ctl & TBCLR)
+        {
+            *timers[i].ctl &= ~TBCLR;   // Self-clearing on the target
+            *timers[i].r = 0;
+            timers[i].divider_count = 0;
+        }
+    }
+
+    service_interrupts();
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        if (uses_clock(&timers[i], TBSSEL__ACLK))
+        {
+            timer_clock(&timers[i], i);
+        }
+    }
+
+    // SMCLK cycles in this ACLK tick, carrying the remainder so the average rate is exact.
+    smclk_fraction += CLOCK_SMCLK_HZ;
+    uint32_t cycles = smclk_fraction / CLOCK_ACLK_HZ;
+    smclk_fraction %= CLOCK_ACLK_HZ;
+    uart_clock(cycles);
+    while (cycles--)
+    {
+        for (i = 0; i < TIMER_COUNT; i++)
+        {
+            if (uses_clock(&timers[i], TBSSEL__SMCLK))
+            {
+                timer_clock(&timers[i], i);
+            }
+        }
+    }
+
+    for (i = 0; i < BUS_COUNT; i++)
+    {
+        i2c_master_clock(&buses[i]);
+    }
+    service_interrupts();
+
+    ticks++;
+}
+
+#endif // HAL_SIM
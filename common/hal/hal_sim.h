@@ -0,0 +1,346 @@
+/**
+ * @file
+ * @brief Linux simulation backend for hal.h.
+ *
+ * Declares the MSP430 registers the firmware uses as plain variables, with the
+ * real bit values, and the compiler intrinsics as functions. hal_sim.c models
+ * the peripherals behind them:
+ *
+ * - GPIO: ports 1 - 6. Inputs are set by the simulator, edges raise the port
+ *   interrupts on P1 - P4.
+ * - Timer_B: TB0 - TB3 in up and continuous mode from ACLK or SMCLK, compare
+ *   and overflow interrupts, and TB2.1 as the ADC trigger.
+ * - ADC: timer-triggered single channel and sequence modes, reading
+ *   hal_sim_adc_set_input() values.
+ * - eUSCI_B0/B1 I2C: master transmit to a hal_sim_i2c_device, and slave
+ *   receive driven by hal_sim_i2c_slave_*().
+ * - eUSCI_A1 UART: transmit only, paced by UCA1BRW and UCA1MCTLW, each byte
+ *   handed to hal_sim_uart_set_tx_hook().
+ *
+ * Time advances one ACLK tick (1/32768 s) per hal_sim_step(). Interrupts are
+ * only taken inside hal_sim_step() and the hal_sim_i2c_slave_*() calls, never
+ * while firmware code is running, so the firmware sees the same ordering it
+ * would with interrupts disabled around its critical sections.
+ *
+ * All state is per process image, so loading each firmware as its own shared
+ * object with RTLD_LOCAL gives each node its own register file.
+ */
+
+#ifndef HAL_SIM_H
+#define HAL_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// PERSISTENT and LOCATION place data in the target's FRAM. Here every variable is ordinary RAM, so they mean nothing.
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"
+
+//---------------- Registers ----------------
+
+#define HAL_SIM_PORT(n) \
+    extern volatile uint8_t P##n##OUT, P##n##IN, P##n##DIR, P##n##SEL0, P##n##SEL1, P##n##REN, \
+                            P##n##IE, P##n##IES, P##n##IFG;
+HAL_SIM_PORT(1)
+HAL_SIM_PORT(2)
+HAL_SIM_PORT(3)
+HAL_SIM_PORT(4)
+HAL_SIM_PORT(5)
+HAL_SIM_PORT(6)
+
+#define HAL_SIM_TIMER(n) \
+    extern volatile uint16_t TB##n##CTL, TB##n##R, TB##n##CCR0, TB##n##CCR1, TB##n##CCR2, \
+                             TB##n##CCTL0, TB##n##CCTL1, TB##n##CCTL2, TB##n##IV;
+HAL_SIM_TIMER(0)
+HAL_SIM_TIMER(1)
+HAL_SIM_TIMER(2)
+HAL_SIM_TIMER(3)
+
+#define HAL_SIM_EUSCI_B(n) \
+    extern volatile uint16_t UCB##n##CTLW0, UCB##n##CTLW1, UCB##n##BRW, UCB##n##STATW, UCB##n##I2COA0, \
+                             UCB##n##I2CSA, UCB##n##IE, UCB##n##IFG, UCB##n##IV, UCB##n##TXBUF, UCB##n##RXBUF;
+HAL_SIM_EUSCI_B(0)
+HAL_SIM_EUSCI_B(1)
+
+extern volatile uint16_t UCA1CTLW0, UCA1BRW, UCA1MCTLW, UCA1IE, UCA1IFG, UCA1IV, UCA1TXBUF;
+
+extern volatile uint16_t ADCCTL0, ADCCTL1, ADCCTL2, ADCMCTL0, ADCMEM0, ADCIE, ADCIFG, ADCIV;
+extern volatile uint16_t WDTCTL, PM5CTL0, FRCTL0, SYSCFG0, SYSRSTIV;
+extern volatile uint16_t CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL5, CSCTL6, CSCTL7, CSCTL8;
+
+//---------------- Bits ----------------
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+// Status register
+#define GIE 0x0008
+#define CPUOFF 0x0010
+#define OSCOFF 0x0020
+#define SCG0 0x0040
+#define SCG1 0x0080
+#define LPM0_bits (CPUOFF)
+#define LPM3_bits (SCG1 | SCG0 | CPUOFF)
+#define LPM4_bits (SCG1 | SCG0 | OSCOFF | CPUOFF)
+
+// Watchdog, PMM, FRAM, clock system
+#define WDTPW 0x5A00
+#define WDTHOLD 0x0080
+#define LOCKLPM5 0x0001
+#define FRCTLPW 0xA500
+#define FRWPPW 0xA500
+#define PFWP 0x0001
+#define DFWP 0x0002
+#define SYSRSTIV_NONE 0x0000
+#define SYSRSTIV_BOR 0x0002
+#define SYSRSTIV_SVSHIFG 0x000E
+#define NWAITS_0 0x0000
+#define NWAITS_1 0x0010
+#define NWAITS_2 0x0020
+#define DCORSEL_0 0x0000
+#define DCORSEL_3 0x0006
+#define DCORSEL_5 0x000A
+#define DCORSEL_7 0x000E
+#define FLLD_0 0x0000
+#define SELREF__REFOCLK 0x0010
+#define FLLUNLOCK0 0x0100
+#define FLLUNLOCK1 0x0200
+#define SELMS__DCOCLKDIV 0x0000
+#define SELA__REFOCLK 0x0100
+
+// Timer_B
+#define TBIFG 0x0001
+#define TBIE 0x0002
+#define TBCLR 0x0004
+#define MC 0x0030
+#define MC__STOP 0x0000
+#define MC__UP 0x0010
+#define MC__CONTINUOUS 0x0020
+#define MC__UPDOWN 0x0030
+#define ID 0x00C0
+#define ID__1 0x0000
+#define ID__2 0x0040
+#define ID__4 0x0080
+#define ID__8 0x00C0
+#define TBSSEL 0x0300
+#define TBSSEL__ACLK 0x0100
+#define TBSSEL__SMCLK 0x0200
+#define CCIFG 0x0001
+#define CCIE 0x0010
+#define OUTMOD 0x00E0
+#define OUTMOD_7 0x00E0
+
+// ADC
+#define ADCSC 0x0001
+#define ADCENC 0x0002
+#define ADCON 0x0010
+#define ADCMSC 0x0080
+#define ADCSHT_2 0x0200
+#define ADCCONSEQ 0x0006
+#define ADCCONSEQ_0 0x0000
+#define ADCCONSEQ_1 0x0002
+#define ADCCONSEQ_2 0x0004
+#define ADCCONSEQ_3 0x0006
+#define ADCSSEL_2 0x0010
+#define ADCDIV_1 0x0020
+#define ADCSHP 0x0200
+#define ADCSHS 0x0C00
+#define ADCSHS_0 0x0000
+#define ADCSHS_3 0x0C00
+#define ADCRES_2 0x0020
+#define ADCINCH 0x000F
+#define ADCINCH_1 0x0001
+#define ADCIE0 0x0001
+#define ADCIFG0 0x0001
+#define ADCOVIFG 0x0010
+
+// eUSCI_B I2C
+#define UCSWRST 0x0001
+#define UCTXSTT 0x0002
+#define UCTXSTP 0x0004
+#define UCTXNACK 0x0008
+#define UCTR 0x0010
+#define UCSSEL_3 0x00C0
+#define UCSYNC 0x0100
+#define UCMODE_3 0x0600
+#define UCMST 0x0800
+#define UCCLTO_1 0x0040
+#define UCOAEN 0x0400
+#define UCGCEN 0x8000
+#define UCBBUSY 0x0010
+#define UCGC 0x0020
+#define UCSCLLOW 0x0040
+#define UCRXIE0 0x0001
+#define UCTXIE0 0x0002
+#define UCSTTIE 0x0004
+#define UCSTPIE 0x0008
+#define UCALIE 0x0010
+#define UCNACKIE 0x0020
+#define UCCLTOIE 0x0080
+#define UCRXIFG0 0x0001
+#define UCTXIFG0 0x0002
+#define UCSTTIFG 0x0004
+#define UCSTPIFG 0x0008
+#define UCALIFG 0x0010
+#define UCNACKIFG 0x0020
+#define UCCLTOIFG 0x0080
+
+// eUSCI_A UART
+#define UCSSEL__SMCLK 0x0080
+#define UCOS16 0x0001
+#define UCTXIE 0x0002
+#define UCTXIFG 0x0002
+
+//---------------- Interrupts ----------------
+
+enum hal_sim_vector
+{
+    PORT1_VECTOR,
+    PORT2_VECTOR,
+    PORT3_VECTOR,
+    PORT4_VECTOR,
+    TIMER0_B0_VECTOR,
+    TIMER0_B1_VECTOR,
+    TIMER1_B0_VECTOR,
+    TIMER1_B1_VECTOR,
+    TIMER2_B0_VECTOR,
+    TIMER2_B1_VECTOR,
+    TIMER3_B0_VECTOR,
+    TIMER3_B1_VECTOR,
+    ADC_VECTOR,
+    USCI_B0_VECTOR,
+    USCI_B1_VECTOR,
+    USCI_A1_VECTOR,
+    HAL_SIM_VECTOR_COUNT
+};
+
+void hal_sim_register_isr(enum hal_sim_vector vector, void (*isr)(void));
+
+// Plain function, registered with the simulator before main() runs.
+#define HAL_ISR(v, name) \
+    void name(void); \
+    static void __attribute__((constructor)) name##_register(void) { hal_sim_register_isr(v, name); } \
+    void name(void)
+
+//---------------- Intrinsics ----------------
+
+void __enable_interrupt(void);
+void __disable_interrupt(void);
+uint16_t __get_interrupt_state(void);
+void __set_interrupt_state(uint16_t state);
+void __bis_SR_register(uint16_t bits);
+void __bic_SR_register(uint16_t bits);
+void __bic_SR_register_on_exit(uint16_t bits);
+void __delay_cycles(unsigned long cycles);
+void __no_operation(void);
+
+//---------------- Simulator interface ----------------
+
+/**
+ * Something on an I2C bus the simulated master can address.
+ */
+struct hal_sim_i2c_device
+{
+    /** Address phase. Return true to acknowledge. */
+    bool (*start)(void *context, uint8_t address);
+
+    /** One data byte from the master */
+    void (*byte)(void *context, uint8_t data);
+
+    /** STOP after an acknowledged transaction */
+    void (*stop)(void *context);
+
+    void *context;
+};
+
+/**
+ * Advance time by one ACLK tick, running any interrupts that fall due.
+ */
+void hal_sim_step(void);
+
+/**
+ * Check whether the firmware is in a low-power mode waiting for an interrupt.
+ *
+ * @return: true from the sleep at the end of app_poll() until an ISR wakes it.
+ */
+bool hal_sim_sleeping(void);
+
+/**
+ * Get the simulated time.
+ *
+ * @return: ACLK ticks since start.
+ */
+uint32_t hal_sim_ticks(void);
+
+/**
+ * Register a function to run at the start of every step, e.g. to drive input pins from output pins.
+ *
+ * @param: hook Function to call, or NULL for none.
+ */
+void hal_sim_set_step_hook(void (*hook)(void));
+
+/**
+ * Register a function to run from __delay_cycles().
+ *
+ * The firmware only busy-waits to hold outputs steady, e.g. the HD44780 enable
+ * strobe, which starts and ends inside one ISR. This is where a model of the
+ * hardware on those pins gets to see them.
+ *
+ * @param: hook Function to call, or NULL for none.
+ */
+void hal_sim_set_delay_hook(void (*hook)(void));
+
+/**
+ * Set the voltage on an ADC input.
+ *
+ * @param: input ADC input number, An.
+ * @param: code 12-bit conversion result it should read as.
+ */
+void hal_sim_adc_set_input(uint8_t input, uint16_t code);
+
+/**
+ * Attach the device the simulated master on a bus talks to.
+ *
+ * @param: bus 0 for eUSCI_B0, 1 for eUSCI_B1.
+ * @param: device Device, or NULL to leave the bus empty so every address is NACKed.
+ */
+void hal_sim_i2c_attach(uint8_t bus, const struct hal_sim_i2c_device *device);
+
+/**
+ * Register a function to get each byte eUSCI_A1 finishes sending.
+ *
+ * @param: hook Function to call, or NULL to drop the bytes.
+ */
+void hal_sim_uart_set_tx_hook(void (*hook)(uint8_t data));
+
+/**
+ * Address the simulated slave on a bus.
+ *
+ * @param: bus 0 for eUSCI_B0, 1 for eUSCI_B1.
+ * @param: address 7-bit address, 0x00 for a general call.
+ *
+ * @return: true if the slave acknowledged.
+ */
+bool hal_sim_i2c_slave_start(uint8_t bus, uint8_t address);
+
+/**
+ * Send a byte to the simulated slave addressed by hal_sim_i2c_slave_start().
+ *
+ * @param: bus 0 for eUSCI_B0, 1 for eUSCI_B1.
+ * @param: data Byte to receive.
+ */
+void hal_sim_i2c_slave_byte(uint8_t bus, uint8_t data);
+
+/**
+ * End the transaction with the simulated slave.
+ *
+ * @param: bus 0 for eUSCI_B0, 1 for eUSCI_B1.
+ */
+void hal_sim_i2c_slave_stop(uint8_t bus);
+
+#endif // HAL_SIM_H
@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @brief Cycle counts for ISRs and other short sections, compiled in with ISR_PROFILE.
+ */
+
+#include "isr_profile.h"
+
+#ifdef ISR_PROFILE
+
+#include "hal.h"
+#include "status_frame.h"
+
+struct isr_profile isr_profiles[ISR_PROFILE_COUNT];
+volatile uint16_t *isr_profile_timer;
+
+static uint8_t cycle_shift;
+
+void isr_profile_init(volatile uint16_t *timer, uint8_t shift)
+{
+    isr_profile_timer = timer;
+    cycle_shift = shift;
+
+    int i;
+    for (i = 0; i < ISR_PROFILE_COUNT; i++)
+    {
+        isr_profiles[i].calls = 0;
+        isr_profiles[i].total = 0;
+        isr_profiles[i].min = 0xFFFF;
+        isr_profiles[i].max = 0;
+        isr_profiles[i].budget = 0xFFFF;
+        isr_profiles[i].overruns = 0;
+    }
+}
+
+void isr_profile_set_budget(enum isr_profile_id id, uint16_t cycles)
+{
+    isr_profiles[id].budget = cycles;
+}
+
+void isr_profile_record(enum isr_profile_id id, uint16_t start)
+{
+    // Unsigned subtraction is right across a timer wrap, as long as the section is shorter than one.
+    uint32_t cycles = (uint32_t)(uint16_t)(*isr_profile_timer - start) << cycle_shift;
+    uint16_t elapsed = cycles > 0xFFFF ? 0xFFFF : cycles;
+    struct isr_profile *profile = &isr_profiles[id];
+
+    if (elapsed < profile->min)
+    {
+        profile->min = elapsed;
+    }
+    if (elapsed > profile->max)
+    {
+        profile->max = elapsed;
+    }
+    if (elapsed > profile->budget && profile->overruns != 0xFFFF)
+    {
+        profile->overruns++;
+    }
+
+    // Halving both keeps the mean while making room, so a long run never wraps the total.
+    if (profile->total > 0xFFFFFFFFUL - elapsed)
+    {
+        profile->total >>= 1;
+        profile->calls >>= 1;
+    }
+    profile->total += elapsed;
+    profile->calls++;
+}
+
+void isr_profile_summarise(struct isr_profile_summary *summary, uint8_t id)
+{
+    summary->id = id;
+    if (id >= ISR_PROFILE_COUNT || isr_profiles[id].calls == 0)
+    {
+        summary->overruns = 0;
+        summary->min = 0;
+        summary->mean = 0;
+        summary->max = 0;
+        return;
+    }
+
+    // Entries timing an ISR change under us, take a consistent copy.
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    struct isr_profile profile = isr_profiles[id];
+    __set_interrupt_state(interrupt_state);
+
+    summary->overruns = profile.overruns;
+    summary->min = profile.min;
+    summary->mean = profile.total / profile.calls;
+    summary->max = profile.max;
+}
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value)
+{
+    *out++ = value & 0xFF;
+    *out++ = value >> 8;
+    return out;
+}
+
+static uint16_t get_u16(const uint8_t *in)
+{
+    return in[0] | ((uint16_t)in[1] << 8);
+}
+
+uint8_t isr_profile_encode(uint8_t *frame, uint8_t id)
+{
+    struct isr_profile_summary summary;
+    isr_profile_summarise(&summary, id);
+
+    uint8_t *out = frame;
+    *out++ = ISR_PROFILE_FRAME_HEADER;
+    *out++ = id;
+    out = put_u16(out, summary.overruns);
+    out = put_u16(out, summary.min);
+    out = put_u16(out, summary.mean);
+    out = put_u16(out, summary.max);
+    *out = status_frame_crc8(frame, ISR_PROFILE_FRAME_LENGTH - 1);
+    return ISR_PROFILE_FRAME_LENGTH;
+}
+
+bool isr_profile_decode(struct isr_profile_summary *summary, const uint8_t *frame, uint8_t length)
+{
+    if (length != ISR_PROFILE_FRAME_LENGTH || frame[0] != ISR_PROFILE_FRAME_HEADER ||
+        status_frame_crc8(frame, ISR_PROFILE_FRAME_LENGTH - 1) != frame[ISR_PROFILE_FRAME_LENGTH - 1])
+    {
+        return false;
+    }
+
+    summary->id = frame[1];
+    summary->overruns = get_u16(&frame[2]);
+    summary->min = get_u16(&frame[4]);
+    summary->mean = get_u16(&frame[6]);
+    summary->max = get_u16(&frame[8]);
+    return true;
+}
+
+#endif // ISR_PROFILE
@@ -0,0 +1,147 @@
+/**
+ * @file
+ * @brief Cycle counts for ISRs and other short sections, compiled in with ISR_PROFILE.
+ *
+ * Wrap a section in ISR_PROFILE_START() and ISR_PROFILE_END(id) and every run
+ * is timed against a free-running 16-bit timer clocked from SMCLK, which runs
+ * at MCLK on both nodes, so counts are CPU cycles. Each entry keeps its
+ * min / max / mean and how often it ran longer than its budget. Interrupt
+ * entry and the compiler's register saves aren't counted, and main loop
+ * sections include any ISRs that interrupt them.
+ *
+ * Without the ISR_PROFILE predefined symbol the macros expand to nothing and
+ * isr_profile.c is empty.
+ *
+ * The controller can send one entry to the LCD as a profile frame:
+ *
+ *     [header] [id] [overruns] [min] [mean] [max] [CRC-8]
+ *
+ * with 16-bit little-endian values and the status frame CRC over every byte
+ * before it. The header's upper nibble can't be a status frame version, so
+ * the LCD tells the two apart by the first byte.
+ */
+
+#ifndef ISR_PROFILE_H
+#define ISR_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ISR_PROFILE_FRAME_HEADER 0xD1
+#define ISR_PROFILE_FRAME_LENGTH 11
+
+/**
+ * Everything either node profiles. Each node only fills in its own entries.
+ */
+enum isr_profile_id
+{
+    ISR_PROFILE_KEYPAD_TICK,    // Controller keypad_timer_expired(), timer wheel ISR
+    ISR_PROFILE_ADC,            // Controller ADC_ISR
+    ISR_PROFILE_TEMPERATURE,    // Controller adc_sampler_update() and get_temperature(), main loop
+    ISR_PROFILE_LCD_I2C,        // LCD USCI_B0_ISR
+    ISR_PROFILE_LCD_WRITE,      // LCD lcd_write(), main loop
+    ISR_PROFILE_COUNT
+};
+
+/**
+ * Timings of one section, in CPU cycles.
+ */
+struct isr_profile
+{
+    /** Runs counted in total; halved along with it when total would overflow */
+    uint32_t calls;
+
+    /** Sum of all counted runs */
+    uint32_t total;
+
+    uint16_t min;
+    uint16_t max;
+
+    /** Runs longer than this count as overruns, 0xFFFF to never count one */
+    uint16_t budget;
+
+    /** Runs longer than budget, saturating */
+    uint16_t overruns;
+};
+
+/**
+ * One entry as carried by a profile frame.
+ */
+struct isr_profile_summary
+{
+    uint8_t id;
+    uint16_t overruns;
+    uint16_t min;
+    uint16_t mean;
+    uint16_t max;
+};
+
+#ifdef ISR_PROFILE
+
+extern struct isr_profile isr_profiles[ISR_PROFILE_COUNT];
+extern volatile uint16_t *isr_profile_timer;
+
+#define ISR_PROFILE_START() uint16_t isr_profile_start = *isr_profile_timer
+#define ISR_PROFILE_END(id) isr_profile_record((id), isr_profile_start)
+
+/**
+ * Clear every entry and set the time base.
+ *
+ * @param: timer Counter register of a timer running continuously from SMCLK, e.g. &TB0R.
+ * @param: shift log2 of the timer's input divider, so counts << shift are cycles.
+ */
+void isr_profile_init(volatile uint16_t *timer, uint8_t shift);
+
+/**
+ * Set how long a section may take before a run counts as an overrun.
+ *
+ * @param: id Entry to set.
+ * @param: cycles Budget in CPU cycles.
+ */
+void isr_profile_set_budget(enum isr_profile_id id, uint16_t cycles);
+
+/**
+ * Count one run. Use ISR_PROFILE_END() rather than calling this directly.
+ *
+ * @param: id Entry to update.
+ * @param: start Timer count when the section started.
+ */
+void isr_profile_record(enum isr_profile_id id, uint16_t start);
+
+/**
+ * Build a profile frame for one entry.
+ *
+ * @param: frame Output buffer, at least ISR_PROFILE_FRAME_LENGTH bytes.
+ * @param: id Entry to send. An id of ISR_PROFILE_COUNT sends an empty entry, which ends the readout.
+ *
+ * @return: Frame length.
+ */
+uint8_t isr_profile_encode(uint8_t *frame, uint8_t id);
+
+/**
+ * Summarise a local entry the same way a frame would.
+ *
+ * @param: summary Output.
+ * @param: id Entry to read.
+ */
+void isr_profile_summarise(struct isr_profile_summary *summary, uint8_t id);
+
+/**
+ * Check a received profile frame.
+ *
+ * @param: summary Output, only written if the frame is valid.
+ * @param: frame Received bytes.
+ * @param: length Number of bytes received.
+ *
+ * @return: true if the frame was a valid profile frame.
+ */
+bool isr_profile_decode(struct isr_profile_summary *summary, const uint8_t *frame, uint8_t length);
+
+#else
+
+#define ISR_PROFILE_START()
+#define ISR_PROFILE_END(id)
+
+#endif // ISR_PROFILE
+
+#endif // ISR_PROFILE_H
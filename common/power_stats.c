@@ -0,0 +1,46 @@
+/**
+ * @file
+ * @brief Active vs. sleep time accounting for the low-power main loops.
+ */
+
+#include "power_stats.h"
+
+void power_stats_init(struct power_stats *stats, uint32_t now)
+{
+    stats->active_ticks = 0;
+    stats->sleep_ticks = 0;
+    stats->wakeups = 0;
+    stats->last_transition = now;
+}
+
+void power_stats_sleep(struct power_stats *stats, uint32_t now)
+{
+    // Unsigned subtraction keeps deltas correct across timestamp wraparound.
+    stats->active_ticks += now - stats->last_transition;
+    stats->last_transition = now;
+}
+
+void power_stats_wake(struct power_stats *stats, uint32_t now)
+{
+    stats->sleep_ticks += now - stats->last_transition;
+    stats->last_transition = now;
+    stats->wakeups++;
+}
+
+uint16_t power_stats_active_permille(const struct power_stats *stats)
+{
+    uint32_t total = stats->active_ticks + stats->sleep_ticks;
+    if (total == 0)
+    {
+        return 1000;
+    }
+
+    // Scale both down until the multiply by 1000 can't overflow.
+    uint32_t active = stats->active_ticks;
+    while (total > 0x3FFFFF)
+    {
+        total >>= 1;
+        active >>= 1;
+    }
+    return (uint16_t)((active * 1000) / total);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief Active vs. sleep time accounting for the low-power main loops.
+ *
+ * The main loop calls power_stats_sleep() right before entering an LPM and
+ * power_stats_wake() at the top of its next pass, app_poll() on both nodes,
+ * passing a free-running timestamp each time. The wake-up is counted there
+ * rather than right after the LPM entry because under HAL_SIM that entry
+ * returns at once and the simulator only resumes the loop, with a fresh
+ * app_poll() call, once an interrupt would have woken it. On the MSP430 the
+ * two points are the same instant. Time between a wake and the next sleep is
+ * counted as active, time between a sleep and the next wake as asleep.
+ * Interrupts serviced while the CPU stays asleep are counted as sleep time.
+ *
+ * The module doesn't care what the timestamp unit is; both nodes use 32768 Hz
+ * ACLK ticks.
+ */
+
+#ifndef POWER_STATS_H
+#define POWER_STATS_H
+
+#include <stdint.h>
+
+/**
+ * Running totals for one node.
+ */
+struct power_stats
+{
+    /** Ticks spent with the CPU running the main loop */
+    uint32_t active_ticks;
+
+    /** Ticks spent in a low-power mode */
+    uint32_t sleep_ticks;
+
+    /** Number of times the main loop was woken from a low-power mode */
+    uint32_t wakeups;
+
+    /** Timestamp of the last sleep or wake */
+    uint32_t last_transition;
+};
+
+/**
+ * Clear the totals and start counting active time from now.
+ *
+ * @param: stats Totals to reset.
+ * @param: now Current timestamp.
+ */
+void power_stats_init(struct power_stats *stats, uint32_t now);
+
+/**
+ * Record that the CPU is about to enter a low-power mode.
+ *
+ * @param: stats Totals to update.
+ * @param: now Current timestamp.
+ */
+void power_stats_sleep(struct power_stats *stats, uint32_t now);
+
+/**
+ * Record that the CPU has left a low-power mode, from the first main loop
+ * pass after it.
+ *
+ * @param: stats Totals to update.
+ * @param: now Current timestamp.
+ */
+void power_stats_wake(struct power_stats *stats, uint32_t now);
+
+/**
+ * Share of the time the CPU has been active.
+ *
+ * @param: stats Totals to read.
+ *
+ * @return: Active time in tenths of a percent, 0 - 1000.
+ */
+uint16_t power_stats_active_permille(const struct power_stats *stats);
+
+#endif // POWER_STATS_H
@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief Run-to-completion task scheduler for the main loops, with deadline statistics.
+ */
+
+#include "hal.h"
+#include "scheduler.h"
+
+void scheduler_init(struct scheduler *scheduler, struct scheduler_task *tasks, uint8_t count,
+                    uint32_t (*clock)(void))
+{
+    scheduler->tasks = tasks;
+    scheduler->count = count;
+    scheduler->clock = clock;
+    scheduler->pending = 0;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        tasks[i].posted_at = 0;
+        tasks[i].worst_latency = 0;
+        tasks[i].runs = 0;
+        tasks[i].misses = 0;
+    }
+}
+
+void scheduler_post(struct scheduler *scheduler, uint8_t task)
+{
+    uint16_t bit = 1u << task;
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    // Only the first post is timed; later ones are already covered by the run to come.
+    if (!(scheduler->pending & bit))
+    {
+        scheduler->tasks[task].posted_at = scheduler->clock();
+        scheduler->pending |= bit;
+    }
+
+    __set_interrupt_state(interrupt_state);
+}
+
+bool scheduler_run(struct scheduler *scheduler)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    uint16_t pending = scheduler->pending;
+    if (!pending)
+    {
+        __set_interrupt_state(interrupt_state);
+        return false;
+    }
+
+    uint8_t task = 0;
+    while (!(pending & (1u << task)))
+    {
+        task++;
+    }
+
+    // Cleared before the run, so a post while it runs makes it run again rather than being lost.
+    struct scheduler_task *entry = &scheduler->tasks[task];
+    scheduler->pending = pending & ~(1u << task);
+    uint32_t posted_at = entry->posted_at;
+    __set_interrupt_state(interrupt_state);
+
+    entry->run();
+
+    // Unsigned subtraction keeps the latency right across a clock wrap.
+    uint32_t latency = scheduler->clock() - posted_at;
+    if (latency > entry->worst_latency)
+    {
+        entry->worst_latency = latency;
+    }
+    if (latency > entry->deadline && entry->misses != 0xFFFF)
+    {
+        entry->misses++;
+    }
+    entry->runs++;
+    return true;
+}
+
+bool scheduler_pending(const struct scheduler *scheduler)
+{
+    return scheduler->pending != 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @brief Run-to-completion task scheduler for the main loops, with deadline statistics.
+ *
+ * ISRs only capture data and post a task; the work itself runs from the main
+ * loop. Tasks are numbered in priority order, 0 first. Each task is a one-deep
+ * queue: posting a task that is already pending doesn't run it twice, so the
+ * task has to drain whatever its ISR queued (keypad events, received frames).
+ *
+ * scheduler_run() runs the highest priority pending task to completion and
+ * returns, so a higher priority task posted meanwhile goes next. Nothing is
+ * preempted except by ISRs.
+ *
+ * Every run is timed from the first post to the end of the run, on the
+ * clock given to scheduler_init(). Each task keeps its worst latency and how
+ * often that went past its deadline. Both nodes use uptime_ticks(), 32768 Hz.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS 16
+
+/**
+ * One task. run and deadline are set by the application, the rest by the scheduler.
+ */
+struct scheduler_task
+{
+    void (*run)(void);
+
+    /** Latency, in clock ticks, past which a run counts as a miss */
+    uint32_t deadline;
+
+    /** Clock when the task was first posted since it last ran */
+    uint32_t posted_at;
+
+    /** Longest time from post to the end of a run */
+    uint32_t worst_latency;
+
+    /** Completed runs */
+    uint32_t runs;
+
+    /** Runs longer than deadline, saturating */
+    uint16_t misses;
+};
+
+/**
+ * Tasks of one node and which of them are waiting to run.
+ */
+struct scheduler
+{
+    struct scheduler_task *tasks;
+    uint8_t count;
+    uint32_t (*clock)(void);
+
+    /** Bit n set while tasks[n] is waiting to run */
+    volatile uint16_t pending;
+};
+
+/**
+ * Set up a scheduler with nothing pending and clear the tasks' statistics.
+ *
+ * @param: scheduler Scheduler to set up.
+ * @param: tasks Tasks with run and deadline filled in, highest priority first.
+ * @param: count Number of tasks, at most SCHEDULER_MAX_TASKS.
+ * @param: clock Free-running timestamp, safe to call from ISRs.
+ */
+void scheduler_init(struct scheduler *scheduler, struct scheduler_task *tasks, uint8_t count,
+                    uint32_t (*clock)(void));
+
+/**
+ * Mark a task to run from the main loop. Safe from ISRs and the main loop.
+ *
+ * Doesn't wake the CPU, an ISR still has to exit to active mode.
+ *
+ * @param: scheduler Scheduler the task belongs to.
+ * @param: task Index into the task table.
+ */
+void scheduler_post(struct scheduler *scheduler, uint8_t task);
+
+/**
+ * Run the highest priority pending task to completion. Main loop only.
+ *
+ * @param: scheduler Scheduler to run from.
+ *
+ * @return: true if a task ran, false if none was pending.
+ */
+bool scheduler_run(struct scheduler *scheduler);
+
+/**
+ * Check for pending tasks. Call with interrupts disabled before going to sleep.
+ *
+ * @param: scheduler Scheduler to check.
+ *
+ * @return: true if any task is waiting to run.
+ */
+bool scheduler_pending(const struct scheduler *scheduler);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Controller to LCD status frame protocol.
+ */
+
+#include "status_frame.h"
+
+#define VERSION_SHIFT 4
+#define FLAGS_MASK 0x0F
+
+// CRC-8 (poly 0x07) of each nibble value, so the CRC costs two lookups per byte with a 16 byte table.
+static const uint8_t crc8_nibble_table[16] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+    0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+uint8_t status_frame_crc8(const uint8_t *data, uint8_t length)
+{
+    uint8_t crc = 0;
+    while (length--)
+    {
+        crc ^= *data++;
+        crc = (crc << 4) ^ crc8_nibble_table[crc >> 4];
+        crc = (crc << 4) ^ crc8_nibble_table[crc >> 4];
+    }
+    return crc;
+}
+
+uint8_t status_frame_encode(uint8_t *frame, const uint8_t *fields, const uint8_t *baseline, bool keyframe)
+{
+    uint8_t mask = 0;
+    uint8_t length = 2; // Header and mask are filled in last
+
+    int i;
+    for (i = 0; i < STATUS_FIELD_COUNT; i++)
+    {
+        if (keyframe || fields[i] != baseline[i])
+        {
+            mask |= 1 << i;
+            frame[length++] = fields[i];
+        }
+    }
+
+    if (mask == 0)
+    {
+        return 0;
+    }
+
+    frame[0] = (STATUS_FRAME_VERSION << VERSION_SHIFT) | (keyframe ? STATUS_FRAME_KEYFRAME : 0);
+    frame[1] = mask;
+    frame[length] = status_frame_crc8(frame, length);
+    return length + 1;
+}
+
+bool status_frame_decode(uint8_t *fields, const uint8_t *frame, uint8_t length)
+{
+    if (length < STATUS_FRAME_OVERHEAD || length > STATUS_FRAME_MAX_LENGTH)
+    {
+        return false;
+    }
+    if ((frame[0] >> VERSION_SHIFT) != STATUS_FRAME_VERSION)
+    {
+        return false;
+    }
+    if (status_frame_crc8(frame, length - 1) != frame[length - 1])
+    {
+        return false;
+    }
+
+    uint8_t mask = frame[1];
+    if (mask >> STATUS_FIELD_COUNT)
+    {
+        return false; // Fields this version doesn't know about
+    }
+
+    // The payload length has to match the mask exactly, otherwise bytes went missing.
+    uint8_t present = 0;
+    int i;
+    for (i = 0; i < STATUS_FIELD_COUNT; i++)
+    {
+        present += (mask >> i) & 1;
+    }
+    if (present + STATUS_FRAME_OVERHEAD != length)
+    {
+        return false;
+    }
+
+    uint8_t position = 2;
+    for (i = 0; i < STATUS_FIELD_COUNT; i++)
+    {
+        if (mask & (1 << i))
+        {
+            fields[i] = frame[position++];
+        }
+    }
+    return true;
+}
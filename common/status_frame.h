@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief Controller to LCD status frame protocol.
+ *
+ * A status frame carries any subset of the status fields:
+ *
+ *     [header] [field mask] [field]... [CRC-8]
+ *
+ * The header holds the protocol version in its upper nibble and flags in its
+ * lower nibble. Bit n of the field mask says field n is present, and present
+ * fields follow in field order. The CRC-8 (polynomial 0x07, init 0x00) covers
+ * every byte before it.
+ *
+ * The controller only sends fields that differ from what the LCD last
+ * acknowledged, plus a periodic keyframe with every field so a receiver that
+ * missed frames or rebooted catches up. The receiver checks length, version
+ * and CRC before touching its copy of the fields, so a torn frame is dropped
+ * whole.
+ */
+
+#ifndef STATUS_FRAME_H
+#define STATUS_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STATUS_FRAME_VERSION 1
+
+/** Header flag: every field is present and the receiver should take them all */
+#define STATUS_FRAME_KEYFRAME 0x01
+
+/** Header, field mask and CRC */
+#define STATUS_FRAME_OVERHEAD 3
+
+/**
+ * Status fields, in wire order.
+ */
+enum status_field
+{
+    STATUS_FIELD_STATE,         // Screen to show, see the LCD's state_enum
+    STATUS_FIELD_PATTERN,       // Selected LED pattern, 8 for none
+    STATUS_FIELD_TEMP_INT,      // Whole degrees Celsius
+    STATUS_FIELD_TEMP_DEC,      // Tenths of a degree Celsius
+    STATUS_FIELD_WINDOW,        // Moving average window size
+    STATUS_FIELD_COUNT
+};
+
+#define STATUS_FRAME_MAX_LENGTH (STATUS_FRAME_OVERHEAD + STATUS_FIELD_COUNT)
+
+/**
+ * CRC-8 with polynomial 0x07.
+ *
+ * @param: data Bytes to check.
+ * @param: length Number of bytes.
+ *
+ * @return: CRC of the bytes.
+ */
+uint8_t status_frame_crc8(const uint8_t *data, uint8_t length);
+
+/**
+ * Build a frame holding the fields that differ from a baseline.
+ *
+ * @param: frame Output buffer, at least STATUS_FRAME_MAX_LENGTH bytes.
+ * @param: fields Current values, STATUS_FIELD_COUNT bytes.
+ * @param: baseline Values the receiver is known to have, STATUS_FIELD_COUNT bytes.
+ * @param: keyframe true to send every field regardless of the baseline.
+ *
+ * @return: Frame length, or 0 if nothing changed and no keyframe was asked for.
+ */
+uint8_t status_frame_encode(uint8_t *frame, const uint8_t *fields, const uint8_t *baseline, bool keyframe);
+
+/**
+ * Check a received frame and apply the fields it carries.
+ *
+ * Nothing is written unless the whole frame is valid.
+ *
+ * @param: fields Values to update, STATUS_FIELD_COUNT bytes.
+ * @param: frame Received bytes.
+ * @param: length Number of bytes received.
+ *
+ * @return: true if the frame was valid and applied.
+ */
+bool status_frame_decode(uint8_t *fields, const uint8_t *frame, uint8_t length);
+
+#endif // STATUS_FRAME_H
@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief Channel-table driven, timer-triggered, oversampled ADC sampling.
+ */
+
+#include "hal.h"
+#include "clock.h"
+#include "adc_sampler.h"
+#define NO_CHANNEL 0xFF
+
+static struct adc_channel *channel_table;
+static uint8_t channel_count = 0;
+
+static uint8_t input_channel[ADC_SAMPLER_INPUTS];   // Channel index for each input, NO_CHANNEL if unused
+static uint8_t highest_input = 0;                   // Where each pass of the sequence starts
+static uint8_t next_input = 0;                      // Input the next result belongs to
+static uint16_t sequence_mode = ADCCONSEQ_3;        // ADCCONSEQ_2 when only one input is converted
+
+static volatile uint8_t channels_ready = 0;         // Bit per channel with a full window not yet reported
+static adc_sample_handler sample_handler = 0;
+
+static void select_analog_pin(uint8_t input)
+{
+    // Analog function is PxSEL1:PxSEL0 = 11
+    if (input < 8)
+    {
+        P1SEL0 |= 1 << input;
+        P1SEL1 |= 1 << input;
+    }
+    else
+    {
+        P5SEL0 |= 1 << (input - 8);
+        P5SEL1 |= 1 << (input - 8);
+    }
+}
+
+// Stop the sequence at once and re-arm it, so the next trigger converts highest_input again. The ISR counts the
+// inputs down by itself, so this is what puts it back in step after a missed conversion.
+static void restart_sequence(void)
+{
+    ADCCTL1 &= ~ADCCONSEQ;                  // CONSEQ 0 and ENC clear stops any mode immediately
+    ADCCTL0 &= ~ADCENC;
+    ADCIFG &= ~(ADCIFG0 | ADCOVIFG);
+    ADCCTL1 |= sequence_mode;
+    ADCCTL0 |= ADCENC;
+    next_input = highest_input;
+}
+
+void adc_sampler_init(struct adc_channel *channels, uint8_t count, uint8_t window_size)
+{
+    if (count > ADC_SAMPLER_MAX_CHANNELS)
+    {
+        count = ADC_SAMPLER_MAX_CHANNELS;
+    }
+
+    ADCCTL0 &= ~ADCENC;                     // Control bits can only change while disabled
+    TB2CTL = TBCLR;                         // No triggers while the table is rebuilt
+
+    channel_table = channels;
+    channel_count = count;
+    channels_ready = 0;
+    highest_input = 0;
+
+    uint8_t inputs = 0;
+    uint8_t i;
+    for (i = 0; i < ADC_SAMPLER_INPUTS; i++)
+    {
+        input_channel[i] = NO_CHANNEL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        struct adc_channel *channel = &channels[i];
+        if (channel->input >= ADC_SAMPLER_INPUTS)
+        {
+            continue;
+        }
+
+        input_channel[channel->input] = i;
+        inputs++;
+        if (channel->input > highest_input)
+        {
+            highest_input = channel->input;
+        }
+
+        select_analog_pin(channel->input);
+        moving_average_init(&channel->filter, window_size);
+        channel->accumulator = 0;
+        channel->accumulated = 0;
+    }
+
+    // One input converts on its own. A sequence would also convert every input below it, e.g. A0 under the LM19's
+    // A1, which is the P1.0 heartbeat LED, and double the interrupts for nothing.
+    sequence_mode = inputs > 1 ? ADCCONSEQ_3 : ADCCONSEQ_2;
+    uint8_t edges_per_pass = inputs > 1 ? highest_input + 1 : 1;
+
+    ADCCTL0 = ADCSHT_2 | ADCON;
+    ADCCTL1 = ADCSHS_3                      // Trigger from TB2.1B (FR2355 datasheet ADC trigger table)
+            | ADCSHP                        // Sample timer, so each trigger edge runs one full conversion
+            | ADCSSEL_2                     // SMCLK
+            | (CLOCK_ADC_DIVIDER - 1) * ADCDIV_1  // Divided down to 5 MHz or less
+            | sequence_mode;                // Repeat, highest_input down to A0. ADCMSC clear: one input per edge
+    ADCCTL2 = ADCRES_2;                     // 12-bit
+    ADCMCTL0 = highest_input;               // ADCINCHx, the first input of each sequence
+    ADCIE |= ADCIE0;
+    restart_sequence();                     // Armed; conversions start on the timer edges
+
+    // TB2.1 goes high at each CCR0 period boundary (reset/set). One edge per input keeps every channel at
+    // ADC_SAMPLER_RATE_HZ however long the sequence is.
+    TB2CTL |= TBSSEL__ACLK | MC__UP;
+    TB2CCR0 = CLOCK_ACLK_HZ / (ADC_SAMPLER_RATE_HZ * edges_per_pass) - 1;
+    TB2CCR1 = TB2CCR0 / 2;
+    TB2CCTL1 = OUTMOD_7;
+}
+
+void adc_sampler_set_window(uint8_t window_size)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt(); // Filters are pushed from the ADC ISR
+
+    uint8_t i;
+    for (i = 0; i < channel_count; i++)
+    {
+        moving_average_init(&channel_table[i].filter, window_size);
+    }
+    channels_ready = 0;
+
+    __set_interrupt_state(interrupt_state);
+}
+
+void adc_sampler_set_sample_handler(adc_sample_handler handler)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    sample_handler = handler;
+    __set_interrupt_state(interrupt_state);
+}
+
+bool adc_sampler_isr(void)
+{
+    uint16_t code = ADCMEM0;
+
+    // A conversion finished before the last one was read, so this result isn't for next_input. Drop it and start
+    // the sequence over rather than feed every channel its neighbour's samples from here on.
+    if (ADCIFG & ADCOVIFG)
+    {
+        restart_sequence();
+        return false;
+    }
+
+    uint8_t index = input_channel[next_input];
+    if (sequence_mode == ADCCONSEQ_3)
+    {
+        next_input = next_input ? next_input - 1 : highest_input;
+    }
+
+    if (index == NO_CHANNEL)
+    {
+        return false;
+    }
+
+    if (sample_handler)
+    {
+        sample_handler(index, code);
+    }
+
+    struct adc_channel *channel = &channel_table[index];
+    channel->accumulator += code;           // 16 12-bit samples fit exactly in 16 bits
+    if (++channel->accumulated < ADC_SAMPLER_OVERSAMPLE)
+    {
+        return false;
+    }
+
+    // Sum of 4^n samples shifted right by n keeps n bits of the extra resolution.
+    moving_average_push(&channel->filter, channel->accumulator >> TEMPERATURE_OVERSAMPLE_BITS);
+    channel->accumulator = 0;
+    channel->accumulated = 0;
+
+    if (!moving_average_ready(&channel->filter))
+    {
+        return false;
+    }
+
+    channels_ready |= 1 << index;
+    return true;
+}
+
+uint8_t adc_sampler_update(void)
+{
+    __disable_interrupt();
+    uint8_t ready = channels_ready;
+    channels_ready = 0;
+    __enable_interrupt();
+
+    uint8_t i;
+    for (i = 0; i < channel_count; i++)
+    {
+        if (!(ready & (1 << i)))
+        {
+            continue;
+        }
+
+        struct adc_channel *channel = &channel_table[i];
+
+        // The sum is 32 bits, so take the average with the ISR held off rather than risk a torn read.
+        __disable_interrupt();
+        uint16_t code = moving_average_value(&channel->filter);
+        __enable_interrupt();
+
+        channel->filtered = code;
+        *channel->report = channel->convert(code);
+    }
+
+    return ready;
+}
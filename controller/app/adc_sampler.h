@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief Channel-table driven, timer-triggered, oversampled ADC sampling.
+ *
+ * The ADC runs in repeat-sequence mode, converting from the highest input in
+ * the table down to A0, one input per TB2.1B edge. Each result is routed to its
+ * channel with a single table lookup, so the per-conversion interrupt costs the
+ * same however many channels there are. Inputs below the highest one that
+ * aren't in the table are still converted, and their results are discarded.
+ * A table with a single input uses repeat-single-channel mode instead and
+ * converts only that input. A missed conversion (ADCOVIFG) restarts the
+ * sequence so results stay matched to their inputs.
+ *
+ * Each channel sums ADC_SAMPLER_OVERSAMPLE conversions, decimates them to
+ * 12 + TEMPERATURE_OVERSAMPLE_BITS bits and pushes the result into its own
+ * moving average. A channel is flagged ready once its filter holds a full
+ * window, which is the only point that wakes the CPU. adc_sampler_update()
+ * then runs each ready channel's conversion from the main loop and stores the
+ * reading in the channel's report slot.
+ *
+ * Adding a sensor is one table entry:
+ *
+ *     int16_t board_temperature;
+ *     struct adc_channel adc_channels[] = {
+ *         {.input = 1, .convert = temperature_from_adc, .report = &board_temperature},  // LM19 on P1.1 (A1)
+ *     };
+ *
+ * The FR2355 has no DMA or hardware accumulator, so the per-conversion
+ * interrupt can't be avoided entirely; it is kept to a lookup, an add and a
+ * compare.
+ */
+
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "temperature.h"
+#include "moving_average.h"
+
+/** Conversions summed per decimated result; 4^n conversions give n extra bits */
+#define ADC_SAMPLER_OVERSAMPLE (1 << (2 * TEMPERATURE_OVERSAMPLE_BITS))
+
+/** Raw conversions per second on each channel */
+#define ADC_SAMPLER_RATE_HZ 32
+
+/** External inputs A0 - A7 (P1.0 - P1.7) and A8 - A11 (P5.0 - P5.3) */
+#define ADC_SAMPLER_INPUTS 12
+
+/** One ready bit per channel */
+#define ADC_SAMPLER_MAX_CHANNELS 8
+
+/**
+ * Called from the ADC ISR with each raw conversion for a channel, before it is accumulated.
+ *
+ * @param: channel Index into the channel table.
+ * @param: code 12-bit ADCMEM0 result.
+ */
+typedef void (*adc_sample_handler)(uint8_t channel, uint16_t code);
+
+/**
+ * One sensor. The first three fields make up the table entry, set with
+ * designated initializers; the rest is the sampler's state for that channel
+ * and is left zero.
+ */
+struct adc_channel
+{
+    /** ADC input number, An */
+    uint8_t input;
+
+    /** Turns a filtered, oversampled code into the reported reading, e.g. temperature_from_adc */
+    int16_t (*convert)(uint16_t code);
+
+    /** Where adc_sampler_update() writes the latest reading */
+    int16_t *report;
+
+    /** Moving average of decimated samples */
+    struct moving_average filter;
+
+    /** Filtered, oversampled code behind the last report */
+    uint16_t filtered;
+
+    /** Sum of the raw conversions towards the next decimated sample */
+    uint16_t accumulator;
+
+    /** Raw conversions in accumulator */
+    uint8_t accumulated;
+};
+
+/**
+ * Configure the ADC for the channel table and start TB2 triggering it.
+ *
+ * @param: channels Channel table. Must stay valid for as long as sampling runs.
+ * @param: count Number of channels, 1 - ADC_SAMPLER_MAX_CHANNELS. Each input may appear once.
+ * @param: window_size Moving average window for every channel.
+ */
+void adc_sampler_init(struct adc_channel *channels, uint8_t count, uint8_t window_size);
+
+/**
+ * Restart every channel's moving average with a new window size.
+ *
+ * @param: window_size Number of decimated samples to average.
+ */
+void adc_sampler_set_window(uint8_t window_size);
+
+/**
+ * Register a function to see every raw conversion, e.g. to stream it out for filter tuning.
+ *
+ * @param: handler Function to call from the ADC ISR, or NULL for none. It holds off the next conversion's
+ *         interrupt, so keep it to a few microseconds.
+ */
+void adc_sampler_set_sample_handler(adc_sample_handler handler);
+
+/**
+ * Route the latest conversion to its channel. Call from the ADC ISR.
+ *
+ * @return: true if a channel's filter completed a window and the main loop should be woken.
+ */
+bool adc_sampler_isr(void);
+
+/**
+ * Convert every ready channel's filtered value and write it to its report slot.
+ * Call from the main loop.
+ *
+ * @return: Bit mask of the channel indexes that were updated.
+ */
+uint8_t adc_sampler_update(void);
+
+#endif // ADC_SAMPLER_H
@@ -0,0 +1,441 @@
+/**
+ * @file
+ * @brief Queued, coalescing I2C master transmit driver for eUSCI_B0 and eUSCI_B1.
+ */
+
+#include "hal.h"
+#include "clock.h"
+#include "i2c_master.h"
+
+// UCBxIV values
+#define IV_ALIFG 0x02
+#define IV_NACKIFG 0x04
+#define IV_STPIFG 0x08
+#define IV_TXIFG0 0x18
+#define IV_CLTOIFG 0x1C
+
+// Interrupts that stay on between frames. UCSWRST clears them, so they are set again after every reset.
+#define BUS_INTERRUPTS (UCSTPIE | UCNACKIE | UCALIE | UCCLTOIE)
+
+// Half an SCL period of the recovery clock, 100 kHz
+#define RECOVERY_HALF_CYCLES CLOCK_CYCLES_NS(5000)
+#define RECOVERY_CLOCKS 9
+
+// How long a slave may stretch a recovery clock, in half periods: 1 ms
+#define RECOVERY_STRETCH_HALVES 200
+
+/**
+ * The registers one eUSCI_B module is driven through.
+ */
+struct i2c_registers
+{
+    volatile uint16_t *ctlw0;
+    volatile uint16_t *ctlw1;
+    volatile uint16_t *brw;
+    volatile uint16_t *i2csa;
+    volatile uint16_t *ie;
+    volatile uint16_t *txbuf;
+    volatile uint16_t *iv;
+
+    /** TB1 compare channel that times this bus's retry backoff */
+    volatile uint16_t *retry_ccr;
+    volatile uint16_t *retry_cctl;
+
+    /** Port the bus's pins are on, for bus recovery */
+    volatile uint8_t *pin_sel0;
+    volatile uint8_t *pin_dir;
+    volatile uint8_t *pin_out;
+    volatile uint8_t *pin_in;
+    uint8_t sda;
+    uint8_t scl;
+};
+
+static const struct i2c_registers registers[I2C_BUS_COUNT] = {
+    {&UCB0CTLW0, &UCB0CTLW1, &UCB0BRW, &UCB0I2CSA, &UCB0IE, &UCB0TXBUF, &UCB0IV,
+     &TB1CCR1, &TB1CCTL1, &P1SEL0, &P1DIR, &P1OUT, &P1IN, BIT2, BIT3},
+    {&UCB1CTLW0, &UCB1CTLW1, &UCB1BRW, &UCB1I2CSA, &UCB1IE, &UCB1TXBUF, &UCB1IV,
+     &TB1CCR2, &TB1CCTL2, &P4SEL0, &P4DIR, &P4OUT, &P4IN, BIT6, BIT7},
+};
+
+/**
+ * Latest frame posted for one slot.
+ */
+struct i2c_slot
+{
+    uint8_t data[I2C_MAX_FRAME];
+    uint8_t length;
+    uint8_t address;
+    bool pending;
+};
+
+/**
+ * Driver state for one bus.
+ */
+struct i2c_bus
+{
+    struct i2c_slot slots[I2C_BUS_SLOTS];
+
+    /** FIFO of pending slot numbers. A slot is in here at most once, so it can't overflow. */
+    uint8_t queue[I2C_BUS_SLOTS];
+    uint8_t queue_head;
+    uint8_t queue_count;
+
+    /** Copy of the frame on the wire, so posts during a transaction can't tear it */
+    uint8_t frame[I2C_MAX_FRAME];
+    uint8_t frame_length;
+    uint8_t frame_index;
+    uint8_t frame_slot;
+    uint8_t frame_address;
+
+    /** Set when the frame in flight was NACKed; its STOP then schedules a retry instead of completing it */
+    bool frame_failed;
+
+    /** Attempts made at the frame in flight after the first */
+    uint8_t retries;
+
+    /** True from the START of a frame until it completes or is given up on, including any backoff */
+    volatile bool busy;
+
+    i2c_sent_handler on_sent;
+
+    struct i2c_bus_stats stats;
+};
+
+static struct i2c_bus buses[I2C_BUS_COUNT];
+
+// Put the frame in flight on the wire from its first byte.
+static void start_frame(enum i2c_bus_id id)
+{
+    struct i2c_bus *bus = &buses[id];
+    const struct i2c_registers *regs = &registers[id];
+
+    bus->frame_index = 0;
+    bus->frame_failed = false;
+    *regs->i2csa = bus->frame_address;
+    *regs->ctlw0 |= UCTR | UCTXSTT; // Start condition, put master in transmit mode
+    *regs->ie |= UCTXIE0;           // Enable TX interrupt
+}
+
+// Must be called with interrupts disabled.
+static void start_next(enum i2c_bus_id id)
+{
+    struct i2c_bus *bus = &buses[id];
+
+    if (bus->busy || bus->queue_count == 0)
+    {
+        return;
+    }
+
+    bus->frame_slot = bus->queue[bus->queue_head];
+    struct i2c_slot *slot = &bus->slots[bus->frame_slot];
+    bus->queue_head = (bus->queue_head + 1) % I2C_BUS_SLOTS;
+    bus->queue_count--;
+
+    int i;
+    for (i = 0; i < slot->length; i++)
+    {
+        bus->frame[i] = slot->data[i];
+    }
+    bus->frame_length = slot->length;
+    bus->frame_address = slot->address;
+    bus->retries = 0;
+    slot->pending = false;
+
+    bus->busy = true;
+    start_frame(id);
+}
+
+// Finish with the frame in flight, whether it went out or was given up on, and move on.
+static void end_frame(enum i2c_bus_id id)
+{
+    struct i2c_bus *bus = &buses[id];
+
+    bus->busy = false;
+    bus->frame_failed = false;
+    start_next(id);
+}
+
+// Try the frame in flight again after a backoff, or drop it once out of retries.
+static void retry_frame(enum i2c_bus_id id)
+{
+    struct i2c_bus *bus = &buses[id];
+    const struct i2c_registers *regs = &registers[id];
+
+    if (bus->retries >= I2C_MAX_RETRIES)
+    {
+        bus->stats.frames_dropped++;
+        end_frame(id);
+        return;
+    }
+
+    // 1, 2, 4 ... ms. TB1 counts ACLK through all 16 bits, so the compare value wraps with it.
+    uint16_t delay = I2C_RETRY_BACKOFF << bus->retries;
+    *regs->retry_ccr = TB1R + delay;
+    *regs->retry_cctl &= ~CCIFG;
+    *regs->retry_cctl |= CCIE;
+
+    bus->retries++;
+    bus->stats.retries++;
+}
+
+// Take the module out of reset as master again. UCMST only changes under UCSWRST, and an arbitration loss may have
+// dropped it to slave. Must be called with UCSWRST set.
+static void restore_master(const struct i2c_registers *regs)
+{
+    *regs->ctlw0 |= UCMST;
+    *regs->ctlw0 &= ~UCSWRST;
+    *regs->ie |= BUS_INTERRUPTS;
+}
+
+// Let SCL go and wait for it to read high, for as long as a slave may stretch it. False if it never does.
+static bool release_scl(const struct i2c_registers *regs)
+{
+    *regs->pin_dir &= ~regs->scl;
+
+    int wait;
+    for (wait = 0; !(*regs->pin_in & regs->scl); wait++)
+    {
+        if (wait >= RECOVERY_STRETCH_HALVES)
+        {
+            return false;
+        }
+        __delay_cycles(RECOVERY_HALF_CYCLES);
+    }
+    __delay_cycles(RECOVERY_HALF_CYCLES);
+    return true;
+}
+
+// Clock SDA free and leave the bus idle. Standard recovery for a slave stuck mid-byte after a reset or glitch:
+// up to nine SCL pulses until it lets go of SDA, then a STOP. Leaves the module out of reset and configured.
+static void recover_bus(enum i2c_bus_id id)
+{
+    const struct i2c_registers *regs = &registers[id];
+    uint8_t sda = regs->sda;
+    uint8_t scl = regs->scl;
+
+    *regs->ctlw0 |= UCSWRST;
+
+    // Both lines as open-drain GPIO: OUT stays 0, DIR set pulls a line low and DIR clear lets the pull-up have it.
+    // A slave may be holding SCL low, so it is never driven high.
+    *regs->pin_out &= ~(sda | scl);
+    *regs->pin_dir &= ~(sda | scl);
+    *regs->pin_sel0 &= ~(sda | scl);
+
+    bool clocking = release_scl(regs);
+
+    int i;
+    for (i = 0; clocking && i < RECOVERY_CLOCKS && !(*regs->pin_in & sda); i++)
+    {
+        *regs->pin_dir |= scl;
+        __delay_cycles(RECOVERY_HALF_CYCLES);
+        clocking = release_scl(regs);
+    }
+
+    // STOP: SDA low to high while SCL is high. Skipped if a slave still has SCL, there is no bus to stop.
+    if (clocking)
+    {
+        *regs->pin_dir |= scl;
+        *regs->pin_dir |= sda;
+        __delay_cycles(RECOVERY_HALF_CYCLES);
+        if (release_scl(regs))
+        {
+            *regs->pin_dir &= ~sda;
+            __delay_cycles(RECOVERY_HALF_CYCLES);
+        }
+    }
+
+    *regs->pin_dir &= ~(sda | scl);
+    *regs->pin_sel0 |= sda | scl;
+
+    restore_master(regs);
+}
+
+void i2c_master_init(enum i2c_bus_id id, uint16_t prescaler)
+{
+    const struct i2c_registers *regs = &registers[id];
+    struct i2c_bus *bus = &buses[id];
+
+    *regs->ctlw0 = UCSWRST;                                 // Put eUSCI_Bx into reset mode
+    *regs->ctlw0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;   // I2C master, synchronous mode, SMCLK source
+    *regs->ctlw1 = UCCLTO_1;                                // Clock low timeout, a slave holding SCL for ~28 ms
+    *regs->brw = prescaler;
+    *regs->ctlw0 &= ~UCSWRST;                               // Release reset state
+    *regs->ie |= BUS_INTERRUPTS;                            // STOP frees the bus, the rest are faults
+
+    *regs->retry_cctl &= ~(CCIE | CCIFG);
+
+    int i;
+    for (i = 0; i < I2C_BUS_SLOTS; i++)
+    {
+        bus->slots[i].pending = false;
+    }
+    bus->queue_head = 0;
+    bus->queue_count = 0;
+    bus->busy = false;
+    bus->on_sent = 0;
+    bus->stats.frames_sent = 0;
+    bus->stats.frames_coalesced = 0;
+    bus->stats.nacks = 0;
+    bus->stats.arbitration_lost = 0;
+    bus->stats.timeouts = 0;
+    bus->stats.recoveries = 0;
+    bus->stats.retries = 0;
+    bus->stats.frames_dropped = 0;
+
+    // A slave reset mid-transfer by our own reset can still be holding SDA low.
+    if (!(*regs->pin_in & regs->sda))
+    {
+        recover_bus(id);
+        bus->stats.recoveries++;
+    }
+}
+
+bool i2c_master_post(enum i2c_bus_id id, uint8_t slot_number, uint8_t address, const uint8_t *data, uint8_t length)
+{
+    if (slot_number >= I2C_BUS_SLOTS || length == 0 || length > I2C_MAX_FRAME)
+    {
+        return false;
+    }
+
+    struct i2c_bus *bus = &buses[id];
+    struct i2c_slot *slot = &bus->slots[slot_number];
+
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    int i;
+    for (i = 0; i < length; i++)
+    {
+        slot->data[i] = data[i];
+    }
+    slot->length = length;
+    slot->address = address;
+
+    if (slot->pending)
+    {
+        bus->stats.frames_coalesced++; // Latest state wins, the queue position is kept
+    }
+    else
+    {
+        slot->pending = true;
+        bus->queue[(bus->queue_head + bus->queue_count) % I2C_BUS_SLOTS] = slot_number;
+        bus->queue_count++;
+    }
+
+    start_next(id);
+
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+void i2c_master_set_sent_handler(enum i2c_bus_id id, i2c_sent_handler handler)
+{
+    buses[id].on_sent = handler;
+}
+
+bool i2c_master_busy(enum i2c_bus_id id)
+{
+    return buses[id].busy || buses[id].queue_count != 0;
+}
+
+bool i2c_master_timer_isr(enum i2c_bus_id id)
+{
+    struct i2c_bus *bus = &buses[id];
+    const struct i2c_registers *regs = &registers[id];
+
+    *regs->retry_cctl &= ~CCIE;
+
+    // A newer frame posted to the same slot during the backoff replaces this one; it is already queued.
+    if (bus->slots[bus->frame_slot].pending)
+    {
+        end_frame(id);
+    }
+    else
+    {
+        start_frame(id);
+    }
+    return false;
+}
+
+const struct i2c_bus_stats *i2c_master_stats(enum i2c_bus_id id)
+{
+    return &buses[id].stats;
+}
+
+bool i2c_master_isr(enum i2c_bus_id id)
+{
+    bool wake = false;
+    struct i2c_bus *bus = &buses[id];
+    const struct i2c_registers *regs = &registers[id];
+
+    switch (*regs->iv)
+    {
+        case IV_TXIFG0:
+            if (bus->frame_index < bus->frame_length)
+            {
+                *regs->txbuf = bus->frame[bus->frame_index++]; // Load next byte
+            }
+            else
+            {
+                *regs->ctlw0 |= UCTXSTP; // Send stop condition
+                *regs->ie &= ~UCTXIE0;   // Disable TX interrupt after completion
+            }
+            break;
+
+        case IV_STPIFG:
+            // The bus is only free once the STOP is actually on the wire.
+            if (!bus->busy)
+            {
+                break;  // e.g. the STOP that ends a recovery, no frame of ours
+            }
+            if (bus->frame_failed)
+            {
+                retry_frame(id);
+                break;
+            }
+            bus->stats.frames_sent++;
+            if (bus->on_sent)
+            {
+                wake = bus->on_sent(bus->frame_slot, bus->frame, bus->frame_length);
+            }
+            end_frame(id);
+            break;
+
+        case IV_NACKIFG:
+            // Nobody answered the address, e.g. the node is missing or rebooting, or it refused a byte. The master
+            // has to end the transaction itself; its STOP interrupt then schedules the retry.
+            bus->stats.nacks++;
+            bus->frame_failed = true;
+            *regs->ctlw0 |= UCTXSTP;
+            *regs->ie &= ~UCTXIE0;
+            break;
+
+        case IV_ALIFG:
+            // Another master won the bus. The module has already dropped to slave and sends no STOP of its own.
+            bus->stats.arbitration_lost++;
+            *regs->ctlw0 |= UCSWRST;
+            restore_master(regs);
+            if (bus->busy)
+            {
+                retry_frame(id);
+            }
+            break;
+
+        case IV_CLTOIFG:
+            // A slave has held SCL low for the whole timeout, so no START or STOP can get through. Clock it free.
+            // Only a frame in flight is retried; with none, start_next() already has the bus.
+            bus->stats.timeouts++;
+            bus->stats.recoveries++;
+            recover_bus(id);
+            if (bus->busy)
+            {
+                retry_frame(id);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return wake;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Queued, coalescing I2C master transmit driver for eUSCI_B0 and eUSCI_B1.
+ *
+ * Each bus owns a small set of frame slots, one per kind of frame the app
+ * sends (e.g. "LCD status"). Posting a frame copies it into its slot and
+ * queues the slot if it isn't already waiting. Posting again before the slot
+ * has gone out just overwrites it, so bursts of updates collapse into the
+ * latest state instead of flooding the bus. Only one transaction is on the
+ * wire at a time and the frame in flight is a private copy, so posting never
+ * truncates or corrupts it.
+ *
+ * Faults never leave a bus stuck. A NACK (e.g. a missing or rebooting node)
+ * or a lost arbitration retries the frame up to I2C_MAX_RETRIES times with
+ * doubling backoff, timed on TB1's CCR1 (B0) and CCR2 (B1), then drops it. A
+ * slave holding SCL low trips the clock-low timeout, and the bus is clocked
+ * free with the standard nine-pulse recovery before the retry. A frame posted
+ * to the same slot during a backoff replaces the one being retried.
+ */
+
+#ifndef I2C_MASTER_H
+#define I2C_MASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Largest frame that fits in a slot, a temperature log readout frame */
+#define I2C_MAX_FRAME 16
+
+/** Frame slots per bus, which also bounds the queue length */
+#define I2C_BUS_SLOTS 4
+
+/** Attempts after the first before a frame is dropped */
+#define I2C_MAX_RETRIES 3
+
+/** First retry backoff in ACLK ticks, about 1 ms; doubles with each retry */
+#define I2C_RETRY_BACKOFF 33
+
+/**
+ * The eUSCI_B modules that can run as masters.
+ */
+enum i2c_bus_id
+{
+    I2C_BUS_B0,
+    I2C_BUS_B1,
+    I2C_BUS_COUNT
+};
+
+/**
+ * Per-bus counters.
+ */
+struct i2c_bus_stats
+{
+    /** Frames that completed with a STOP */
+    uint16_t frames_sent;
+
+    /** Posts that replaced a frame still waiting in its slot */
+    uint16_t frames_coalesced;
+
+    /** Address or data bytes that weren't acknowledged */
+    uint16_t nacks;
+
+    /** Transactions lost to another master */
+    uint16_t arbitration_lost;
+
+    /** Clock-low timeouts, i.e. a slave holding SCL */
+    uint16_t timeouts;
+
+    /** Nine-clock recoveries run, at init or after a timeout */
+    uint16_t recoveries;
+
+    /** Retries started after a fault */
+    uint16_t retries;
+
+    /** Frames given up on after I2C_MAX_RETRIES */
+    uint16_t frames_dropped;
+};
+
+/**
+ * Called from the bus ISR once a frame has gone out completely and been acknowledged. Not called for dropped frames.
+ *
+ * @param: slot Slot the frame was posted to.
+ * @param: frame The bytes that were sent.
+ * @param: length Number of bytes sent.
+ *
+ * @return: true if the main loop needs to be woken.
+ */
+typedef bool (*i2c_sent_handler)(uint8_t slot, const uint8_t *frame, uint8_t length);
+
+/**
+ * Configure an eUSCI_B module as a single-master transmitter.
+ *
+ * The SDA/SCL pins must already be routed to the module and LOCKLPM5
+ * cleared, and TB1 must be counting ACLK continuously, see uptime_init(), for
+ * the retry backoff. If a slave is holding SDA low, the bus is recovered first.
+ *
+ * @param: bus Module to configure.
+ * @param: prescaler SMCLK divider for SCL, see CLOCK_I2C_PRESCALER().
+ */
+void i2c_master_init(enum i2c_bus_id bus, uint16_t prescaler);
+
+/**
+ * Queue a frame for transmission, replacing any unsent frame in the same slot.
+ *
+ * Safe to call from the main loop or from an ISR.
+ *
+ * @param: bus Bus to send on.
+ * @param: slot Frame slot, 0 - I2C_BUS_SLOTS - 1. One slot per kind of frame.
+ * @param: address 7-bit slave address.
+ * @param: data Frame bytes, copied before returning.
+ * @param: length Number of bytes, 1 - I2C_MAX_FRAME.
+ *
+ * @return: false if the slot or length is out of range, true otherwise.
+ */
+bool i2c_master_post(enum i2c_bus_id bus, uint8_t slot, uint8_t address, const uint8_t *data, uint8_t length);
+
+/**
+ * Register a function to be told about every frame that completes on a bus.
+ *
+ * @param: bus Bus to watch.
+ * @param: handler Function to call from the ISR, or NULL for none.
+ */
+void i2c_master_set_sent_handler(enum i2c_bus_id bus, i2c_sent_handler handler);
+
+/**
+ * Check whether a bus has a transaction in flight or queued.
+ *
+ * @param: bus Bus to check.
+ *
+ * @return: true while there is still something to send.
+ */
+bool i2c_master_busy(enum i2c_bus_id bus);
+
+/**
+ * Get the counters for a bus.
+ *
+ * @param: bus Bus to read.
+ *
+ * @return: Pointer to the bus's counters.
+ */
+const struct i2c_bus_stats *i2c_master_stats(enum i2c_bus_id bus);
+
+/**
+ * Service the bus's interrupt. Call from the matching USCI_Bx ISR.
+ *
+ * @param: bus Bus whose interrupt fired.
+ *
+ * @return: true if the ISR should wake the main loop on exit.
+ */
+bool i2c_master_isr(enum i2c_bus_id bus);
+
+/**
+ * Retry the frame whose backoff has run out. Call from the TB1 CCR1 (B0) or CCR2 (B1) interrupt.
+ *
+ * @param: bus Bus whose retry timer fired.
+ *
+ * @return: true if the ISR should wake the main loop on exit.
+ */
+bool i2c_master_timer_isr(enum i2c_bus_id bus);
+
+#endif // I2C_MASTER_H
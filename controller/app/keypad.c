@@ -0,0 +1,197 @@
+/**
+ * @file
+ * @brief Non-blocking 4x4 keypad scanner.
+ */
+
+#include "hal.h"
+#include "keypad.h"
+
+#define COLUMN_PINS 0x0F
+#define ROW_PINS 0xF0
+
+// 2D Array, each array is a row, each item is a column.
+static const char key_map[KEYPAD_ROWS][KEYPAD_COLUMNS] = {{'1', '2', '3', 'A'},  // Top Row
+                                                          {'4', '5', '6', 'B'},
+                                                          {'7', '8', '9', 'C'},
+                                                          {'*', '0', '#', 'D'}}; // Bottom Row
+
+// Output pattern that drives each column, far left column first.
+static const uint8_t column_drive[KEYPAD_COLUMNS] = {BIT3, BIT2, BIT1, BIT0};
+
+// Input pin for each row, top row first.
+static const uint8_t row_sense[KEYPAD_ROWS] = {BIT7, BIT6, BIT5, BIT4};
+
+static uint8_t column = 0;
+static bool scanning = true;
+static uint8_t quiet_scans = 0;         // Consecutive scans with no row high and no key held
+static uint8_t debounce[KEYPAD_KEYS];   // Per-key integrator, 0 = released, KEYPAD_DEBOUNCE_SCANS = pressed
+static uint16_t pressed_keys = 0;       // Bit n set when key n is debounced as pressed
+
+// Queue indices only ever increase; each side owns one of them.
+static struct keypad_event queue[KEYPAD_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0; // Written by keypad_scan() only
+static volatile uint8_t queue_tail = 0; // Written by keypad_get_event() only
+
+volatile uint16_t keypad_dropped_events = 0;
+volatile uint16_t keypad_wakeups = 0;
+
+static bool queue_push(uint8_t row, uint8_t col, bool pressed)
+{
+    uint8_t head = queue_head;
+    if ((uint8_t)(head - queue_tail) >= KEYPAD_QUEUE_SIZE)
+    {
+        keypad_dropped_events++;
+        return false;
+    }
+
+    struct keypad_event *event = &queue[head & (KEYPAD_QUEUE_SIZE - 1)];
+    event->key = key_map[row][col];
+    event->index = row * KEYPAD_COLUMNS + col;
+    event->pressed = pressed;
+    queue_head = head + 1; // Publish only after the slot is written
+    return true;
+}
+
+void keypad_init(void)
+{
+    // Configure P3 for digital I/O
+    P3SEL0 &= 0x00;
+    P3SEL1 &= 0x00;
+
+    P3DIR &= ~ROW_PINS;  // Rows are inputs
+    P3DIR |= COLUMN_PINS; // Columns are outputs
+
+    P3REN |= ROW_PINS;  // ENABLING the resistors for the rows
+    P3OUT &= 0x00;      // CLEARING output register. This both clears the columns, and sets pull-down resistors on the rows
+
+    int i;
+    for (i = 0; i < KEYPAD_KEYS; i++)
+    {
+        debounce[i] = 0;
+    }
+    pressed_keys = 0;
+    column = 0;
+    quiet_scans = 0;
+    scanning = true;
+
+    P3IE &= ~ROW_PINS;
+    P3IES &= ~ROW_PINS; // Rising edge, for when the scanner goes idle
+
+    // Drive the first column now so it has a full tick to settle before it is read.
+    P3OUT = (P3OUT & ~COLUMN_PINS) | column_drive[column];
+}
+
+static void enter_idle(void)
+{
+    int i;
+    for (i = 0; i < KEYPAD_KEYS; i++)
+    {
+        debounce[i] = 0;
+    }
+    scanning = false;
+
+    // With every column high, any key pulls its row up and raises PORT3.
+    P3OUT |= COLUMN_PINS;
+    P3IFG &= ~ROW_PINS;
+    P3IE |= ROW_PINS;
+
+    // A key that went down after the last scan won't give an edge now that its row is already high.
+    uint8_t rows = P3IN & ROW_PINS;
+    if (rows)
+    {
+        P3IFG |= rows;
+    }
+}
+
+void keypad_wake_isr(void)
+{
+    P3IE &= ~ROW_PINS;
+    P3IFG &= ~ROW_PINS;
+    keypad_wakeups++;
+
+    quiet_scans = 0;
+    column = 0;
+    scanning = true;
+    P3OUT = (P3OUT & ~COLUMN_PINS) | column_drive[column];
+}
+
+bool keypad_scanning(void)
+{
+    return scanning;
+}
+
+bool keypad_scan(void)
+{
+    bool queued = false;
+
+    if (!scanning)
+    {
+        return false;
+    }
+
+    // The current column was driven on the previous call, so the rows have had a whole tick to settle.
+    uint8_t rows = P3IN & ROW_PINS;
+
+    int row;
+    for (row = 0; row < KEYPAD_ROWS; row++)
+    {
+        uint8_t key_index = row * KEYPAD_COLUMNS + column;
+        uint16_t key_bit = 1u << key_index;
+
+        if (rows & row_sense[row])
+        {
+            if (debounce[key_index] < KEYPAD_DEBOUNCE_SCANS)
+            {
+                debounce[key_index]++;
+            }
+            if (debounce[key_index] == KEYPAD_DEBOUNCE_SCANS && !(pressed_keys & key_bit))
+            {
+                pressed_keys |= key_bit;
+                queued |= queue_push(row, column, true);
+            }
+        }
+        else
+        {
+            if (debounce[key_index] > 0)
+            {
+                debounce[key_index]--;
+            }
+            if (debounce[key_index] == 0 && (pressed_keys & key_bit))
+            {
+                pressed_keys &= ~key_bit;
+                queued |= queue_push(row, column, false);
+            }
+        }
+    }
+
+    if (rows || pressed_keys)
+    {
+        quiet_scans = 0;
+    }
+    else if (++quiet_scans >= KEYPAD_IDLE_SCANS)
+    {
+        enter_idle(); // Bounce left in the debounce counters is older than any debounce window, so it's dropped
+        return queued;
+    }
+
+    if (++column >= KEYPAD_COLUMNS)
+    {
+        column = 0;
+    }
+    P3OUT = (P3OUT & ~COLUMN_PINS) | column_drive[column];
+
+    return queued;
+}
+
+bool keypad_get_event(struct keypad_event *event)
+{
+    uint8_t tail = queue_tail;
+    if (tail == queue_head)
+    {
+        return false;
+    }
+
+    *event = queue[tail & (KEYPAD_QUEUE_SIZE - 1)];
+    queue_tail = tail + 1; // Release the slot only after it has been copied
+    return true;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Non-blocking 4x4 keypad scanner.
+ *
+ * keypad_scan() is called from a periodic timer interrupt and advances the
+ * scan by one column per call, so it never waits on a key. Every key has its
+ * own debounce counter, and debounced press/release events are pushed into a
+ * single-producer/single-consumer queue that the main loop drains with
+ * keypad_get_event().
+ *
+ * Columns are driven on P3.3 - P3.0 (left to right) and rows are read on
+ * P3.7 - P3.4 (top to bottom) with pull-downs.
+ *
+ * Scanning only runs while a key is in use. After KEYPAD_IDLE_SCANS quiet
+ * scans the scanner goes idle: every column is driven high and the row pins'
+ * rising-edge port interrupts are armed, so the next press raises PORT3 and
+ * keypad_wake_isr() restarts scanning. While idle, the scan timer can be
+ * stopped altogether.
+ */
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define KEYPAD_ROWS 4
+#define KEYPAD_COLUMNS 4
+#define KEYPAD_KEYS (KEYPAD_ROWS * KEYPAD_COLUMNS)
+
+/** Consecutive scans a key has to agree on before its state changes */
+#define KEYPAD_DEBOUNCE_SCANS 3
+
+/** Number of events the queue holds, must be a power of two */
+#define KEYPAD_QUEUE_SIZE 8
+
+/** Scans with no key down before going back to waiting on the port interrupt, 50 ms at a 1 ms scan */
+#define KEYPAD_IDLE_SCANS 50
+
+/**
+ * Position of each key, row by row from the top left. Used to index lookup tables.
+ */
+enum keypad_key
+{
+    KEY_1, KEY_2, KEY_3, KEY_A,
+    KEY_4, KEY_5, KEY_6, KEY_B,
+    KEY_7, KEY_8, KEY_9, KEY_C,
+    KEY_STAR, KEY_0, KEY_HASH, KEY_D
+};
+
+/**
+ * A debounced change in a key's state.
+ */
+struct keypad_event
+{
+    /** Character printed on the key, e.g. '5' or 'D' */
+    char key;
+
+    /** Position of the key, see enum keypad_key */
+    uint8_t index;
+
+    /** true when the key went down, false when it came back up */
+    bool pressed;
+};
+
+/** Events thrown away because the queue was full */
+extern volatile uint16_t keypad_dropped_events;
+
+/** Times a row interrupt woke the scanner from idle */
+extern volatile uint16_t keypad_wakeups;
+
+/**
+ * Configure port 3 for the keypad and reset the scanner. Starts out scanning.
+ */
+void keypad_init(void);
+
+/**
+ * Sample the current column, update debounce state and move to the next column.
+ *
+ * Intended to be called from a timer ISR, e.g. every 1 ms. Each key is sampled
+ * once every KEYPAD_COLUMNS calls. Does nothing while idle.
+ *
+ * @return: true if an event was queued, i.e. the main loop has work to do.
+ */
+bool keypad_scan(void);
+
+/**
+ * Check whether the scanner needs keypad_scan() calls.
+ *
+ * @return: false while idle and waiting on a row interrupt.
+ */
+bool keypad_scanning(void);
+
+/**
+ * Leave idle and start scanning. Call from the PORT3 ISR.
+ */
+void keypad_wake_isr(void);
+
+/**
+ * Take the oldest event off the queue.
+ *
+ * Only the main loop may call this; keypad_scan() is the only producer.
+ *
+ * @param: event Filled in with the event if one was waiting.
+ *
+ * @return: true if an event was returned, false if the queue was empty.
+ */
+bool keypad_get_event(struct keypad_event *event);
+
+#endif // KEYPAD_H
@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief LED bar pattern engine.
+ */
+
+#include "hal.h"
+#include "led_pattern.h"
+
+// Expand f(n) for n = start ... start + count - 1, so each table below is generated at compile time.
+#define SEQ4(f, n) f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define SEQ8(f, n) SEQ4(f, n), SEQ4(f, (n) + 4)
+#define SEQ32(f, n) SEQ8(f, n), SEQ8(f, (n) + 8), SEQ8(f, (n) + 16), SEQ8(f, (n) + 24)
+#define SEQ256(f, n) SEQ32(f, n), SEQ32(f, (n) + 32), SEQ32(f, (n) + 64), SEQ32(f, (n) + 96), \
+                     SEQ32(f, (n) + 128), SEQ32(f, (n) + 160), SEQ32(f, (n) + 192), SEQ32(f, (n) + 224)
+
+#define COUNT_UP(n) (n)
+#define COUNT_DOWN(n) (255 - (n))
+#define ROTATE_1(n) (1 << (n))                  // One lit LED walking left
+#define ROTATE_7(n) (0xFF & ~(1 << (n)))        // One dark LED walking left
+#define FILL(n) ((2 << (n)) - 1)                // Lit from the right, one more each step
+
+static const uint8_t static_frames[] = {0xAA};
+static const uint8_t break_frames[] = {0xAA, 0x55};
+static const uint8_t up_counter_frames[] = {SEQ256(COUNT_UP, 0)};
+static const uint8_t in_and_out_frames[] = {0x18, 0x24, 0x42, 0x81, 0x42, 0x24};
+static const uint8_t down_counter_frames[] = {SEQ256(COUNT_DOWN, 0)};
+static const uint8_t rotate_1_frames[] = {SEQ8(ROTATE_1, 0)};
+static const uint8_t rotate_7_frames[] = {SEQ8(ROTATE_7, 0)};
+static const uint8_t fill_frames[] = {SEQ8(FILL, 0)};
+
+/**
+ * One pattern's steps.
+ */
+struct sequence
+{
+    const uint8_t *frames;
+    uint16_t length;
+};
+
+#define SEQUENCE(frames) {frames, sizeof(frames)}
+
+static const struct sequence sequences[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_STATIC] = SEQUENCE(static_frames),
+    [LED_PATTERN_BREAK] = SEQUENCE(break_frames),
+    [LED_PATTERN_UP_COUNTER] = SEQUENCE(up_counter_frames),
+    [LED_PATTERN_IN_AND_OUT] = SEQUENCE(in_and_out_frames),
+    [LED_PATTERN_DOWN_COUNTER] = SEQUENCE(down_counter_frames),
+    [LED_PATTERN_ROTATE_1_LEFT] = SEQUENCE(rotate_1_frames),
+    [LED_PATTERN_ROTATE_7_LEFT] = SEQUENCE(rotate_7_frames),
+    [LED_PATTERN_FILL_LEFT] = SEQUENCE(fill_frames),
+};
+
+static const struct sequence *current = 0;
+static uint16_t step = 0;
+static uint16_t period = LED_PATTERN_DEFAULT_PERIOD;
+static volatile uint8_t frame = 0;
+static struct soft_timer *step_timer;
+
+void led_pattern_init(struct soft_timer *timer)
+{
+    step_timer = timer;
+    timer_wheel_stop(step_timer);
+
+    current = 0;
+    frame = 0;
+}
+
+void led_pattern_select(uint8_t pattern)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (pattern >= LED_PATTERN_COUNT)
+    {
+        current = 0;
+        frame = 0;
+        timer_wheel_stop(step_timer);
+    }
+    else
+    {
+        current = &sequences[pattern];
+        step = 0;
+        frame = current->frames[0];
+        timer_wheel_start(step_timer, period, period);
+    }
+
+    __set_interrupt_state(interrupt_state);
+}
+
+void led_pattern_set_period(uint16_t new_period)
+{
+    // The step already scheduled keeps its time, the ones after it use the new period. The pattern carries on.
+    period = new_period ? new_period : 1;
+    timer_wheel_set_period(step_timer, period);
+}
+
+uint8_t led_pattern_frame(void)
+{
+    return frame;
+}
+
+bool led_pattern_step(void)
+{
+    if (!current)
+    {
+        return false;
+    }
+
+    if (++step >= current->length)
+    {
+        step = 0;
+    }
+
+    uint8_t next = current->frames[step];
+    bool changed = next != frame;
+    frame = next;
+    return changed;
+}
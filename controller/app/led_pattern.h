@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief LED bar pattern engine.
+ *
+ * Every pattern the LCD can name is a const table of 8-bit bar states built
+ * by the preprocessor. A periodic timer on the timer wheel marks each step,
+ * so the engine streams the next bar state every `period` wheel ticks. The
+ * period can change at any time without restarting the pattern; the new rate
+ * applies from the next step.
+ */
+
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "timer_wheel.h"
+
+/**
+ * Patterns, in the same order as the LCD's patterns_array.
+ */
+enum led_pattern
+{
+    LED_PATTERN_STATIC,
+    LED_PATTERN_BREAK,
+    LED_PATTERN_UP_COUNTER,
+    LED_PATTERN_IN_AND_OUT,
+    LED_PATTERN_DOWN_COUNTER,
+    LED_PATTERN_ROTATE_1_LEFT,
+    LED_PATTERN_ROTATE_7_LEFT,
+    LED_PATTERN_FILL_LEFT,
+    LED_PATTERN_NONE,       // Bar off, engine stopped
+    LED_PATTERN_COUNT = LED_PATTERN_NONE
+};
+
+/** Default step period, 1 s of wheel ticks */
+#define LED_PATTERN_DEFAULT_PERIOD TIMER_WHEEL_HZ
+
+/**
+ * Stop the engine with the bar off.
+ *
+ * @param: timer Timer to step the pattern with. Its callback must call led_pattern_step().
+ */
+void led_pattern_init(struct soft_timer *timer);
+
+/**
+ * Start a pattern from its first step, or stop the engine with LED_PATTERN_NONE.
+ *
+ * @param: pattern Pattern to show.
+ */
+void led_pattern_select(uint8_t pattern);
+
+/**
+ * Change how long each step lasts without restarting the pattern.
+ *
+ * @param: period Wheel ticks per step, at least 1.
+ */
+void led_pattern_set_period(uint16_t period);
+
+/**
+ * Current bar state.
+ *
+ * @return: One bit per LED, bit 0 on the right.
+ */
+uint8_t led_pattern_frame(void);
+
+/**
+ * Advance to the next step. Call from the expiry callback of the timer given to led_pattern_init().
+ *
+ * @return: true if the bar state changed and needs sending.
+ */
+bool led_pattern_step(void);
+
+#endif // LED_PATTERN_H
@@ -1,151 +1,730 @@
-#include <msp430.h>
+#include "hal.h"
+#include "app.h"
+#include <stdbool.h>
 #include <stdint.h>
-#include <math.h>
+#include <stdlib.h>
+#include "clock.h"
+#include "temperature.h"
+#include "temperature_log.h"
+#include "keypad.h"
+#include "uptime.h"
+#include "timer_wheel.h"
+#include "power_stats.h"
+#include "i2c_master.h"
+#include "status_frame.h"
+#include "led_pattern.h"
+#include "adc_sampler.h"
+#include "peripherals.h"
+#include "isr_profile.h"
+#include "scheduler.h"
+#include "fram_record.h"
+#include "telemetry.h"
 
 /**
  * main.c
  */
 
-#define LCD_ADDRESS 0x01   // Address of the LCD MSP430FR2310
-#define LED_ADDRESS 0X01   // Address of LED Bar MSP
-#define TX_BYTES 5         // Number of bytes to transmit
-#define REF_VOLTAGE 3.3    // ADC reference
+#define TX_BYTES STATUS_FIELD_COUNT // Status fields tracked for the LCD
+#define KEYFRAME_INTERVAL 16        // Every 16th LCD frame carries every field
+
+#define LCD_BUS I2C_BUS_B0 // LCD is on eUSCI_B0, P1.2/P1.3
+#define LED_BUS I2C_BUS_B1 // LED bar is on eUSCI_B1, P4.6/P4.7
+#define I2C_RATE_HZ 100000 // 100 kHz standard mode, 400000 fast mode or 1000000 fast mode plus
+#define I2C_PRESCALER CLOCK_I2C_PRESCALER(I2C_RATE_HZ)
+
+#if I2C_PRESCALER < CLOCK_I2C_MIN_PRESCALER
+#error "SMCLK is too slow for I2C_RATE_HZ, pick a faster CLOCK_MHZ profile"
+#endif
+
+// I2C frame slots. Each kind of frame coalesces with itself, so only the latest one goes out. They are distinct so
+// status and pattern frames can share a bus.
+#define LCD_STATUS_SLOT 0
+#define LED_PATTERN_SLOT 1
+#define ISR_PROFILE_SLOT 2
+#define LOG_READOUT_SLOT 3
+
+#define KEYPAD_SCAN_PERIOD 1                 // Wheel ticks between keypad column steps, about 1 ms
+#define KEYPAD_SCAN_CYCLES (CLOCK_SMCLK_HZ / TIMER_WHEEL_HZ * KEYPAD_SCAN_PERIOD)
+#define UNLOCK_TIMEOUT TIMER_WHEEL_MS(5000) // From the first digit of a code to giving up on it
+#define HEARTBEAT_PERIOD TIMER_WHEEL_HZ     // Heartbeat LEDs toggle once a second
+
+// Every node on the buses. Several nodes of one kind on a bus are reached with a single general call, see
+// peripherals.h. Status frames are deltas against one baseline (lcd_acked), so all LCDs must be on LCD_BUS.
+static const struct peripheral peripheral_table[] = {
+    {PERIPHERAL_LCD, LCD_BUS, 0x01},        // LCD MSP430FR2310, address set in its info FRAM
+    {PERIPHERAL_LED_BAR, LED_BUS, 0x01},    // LED bar MSP
+    {PERIPHERAL_HOST, LCD_BUS, 0x30},       // Temperature log readout; NACKs harmlessly when nothing is attached
+};
+#define PERIPHERAL_COUNT (sizeof(peripheral_table) / sizeof(peripheral_table[0]))
 
 // ADC Data
 int window_size = 3;
-int adc_results[10];
-int sample_index = 0;
-int samples_collected = 0;
 int temperature_integer = 0;
 int temperature_decimal = 0;
 
+int16_t board_temperature = 0;  // Deci-degrees Celsius, from the LM19 on the board
+
+// Analog sensors, see adc_sampler.h. Each entry gets its own oversampling and moving average.
+#define BOARD_TEMPERATURE_CHANNEL 0
+struct adc_channel adc_channels[] = {
+    {.input = 1, .convert = temperature_from_adc, .report = &board_temperature},  // LM19 on P1.1 (A1)
+};
+#define ADC_CHANNEL_COUNT (sizeof(adc_channels) / sizeof(adc_channels[0]))
+
+// Work handed from ISRs to the main loop, highest priority first. See the task table above app_init().
+enum task
+{
+    TASK_KEYS,          // Debounced key events are queued
+    TASK_LCD_STATUS,    // tx_buffer changed from an ISR and needs sending
+    TASK_LED_FRAME,     // Pattern engine stepped to a new bar state
+    TASK_TEMPERATURE,   // An ADC channel has a full filter window
+    TASK_LOG_READOUT,   // Previous readout frame went out, send the next
+    TASK_COUNT
+};
+struct scheduler scheduler;
+
 // I2C Data
-volatile int tx_index = 0;
-char tx_buffer[TX_BYTES] = {0, 8, 0, 0, 3};
+uint8_t tx_buffer[TX_BYTES] = {0, 8, 0, 0, 3};  // Current status, indexed by enum status_field
+uint8_t lcd_acked[TX_BYTES];                     // Status the LCD is known to have, updated as frames complete
+uint8_t frames_since_keyframe = KEYFRAME_INTERVAL; // First frame is always a keyframe
 
-char led_buffer[9] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+// uptime_ticks() when the LCD first acknowledged a status frame, i.e. reset to restored screen; 0 until then.
+volatile uint32_t boot_ticks = 0;
 
-volatile int led_index = 0;
+// Temperature log readout to PERIPHERAL_HOST, one frame in flight at a time.
+struct temperature_log_cursor log_readout;
+bool log_readout_active = false;
 
-void send_I2C_data()
+static void post_status(bool broadcast)
 {
+    // Queues the fields that changed since the LCDs' last complete frame. If the previous frame hasn't gone out yet
+    // it is replaced rather than cut short, which is safe because both are relative to the same baseline.
+    // A broadcast is always a keyframe, so nodes that don't track the baseline can use it as is.
+    uint8_t frame[STATUS_FRAME_MAX_LENGTH];
+    bool keyframe = broadcast || frames_since_keyframe >= KEYFRAME_INTERVAL;
+
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt(); // lcd_acked is updated from the I2C ISR
+    uint8_t length = status_frame_encode(frame, tx_buffer, lcd_acked, keyframe);
+    __set_interrupt_state(interrupt_state);
+
+    if (length == 0)
+    {
+        return;
+    }
 
-    tx_index = 0; // Reset buffer index
-    UCB0CTLW0 |= UCTR | UCTXSTT;  // Start condition, put master in transmit mode
-    UCB0IE |= UCTXIE0; // Enable TX interrupt
+    frames_since_keyframe = keyframe ? 0 : frames_since_keyframe + 1;
+    if (broadcast)
+    {
+        peripherals_broadcast(PERIPHERAL_LCD, LCD_STATUS_SLOT, frame, length);
+    }
+    else
+    {
+        peripherals_post(PERIPHERAL_LCD, LCD_STATUS_SLOT, frame, length);
+    }
 }
 
-void send_led_i2c()
+void send_I2C_data()
 {
+    post_status(false);
+}
+
+void broadcast_status()
+{
+    // Every LCD, whatever its address, one general call per bus with an LCD on it. Used for lock and unlock. The LED
+    // bar learns about those from its own pattern frame, so the status keyframe stays off its bus.
+    post_status(true);
+}
 
-    led_index = 0;
-    UCB1CTLW0 |= UCTR | UCTXSTT;  // Start condition, put master in transmit mode
-    UCB1IE |= UCTXIE1; // Enable TX interrupt
+bool lcd_frame_sent(uint8_t slot, const uint8_t *frame, uint8_t length)
+{
+    // Runs in the UCB0 ISR. The frame is our own, so decoding it gives exactly what the LCDs now hold.
+    if (slot == LOG_READOUT_SLOT)
+    {
+        scheduler_post(&scheduler, TASK_LOG_READOUT);
+        return true;
+    }
+    if (slot != LCD_STATUS_SLOT)
+    {
+        return false;
+    }
+    status_frame_decode(lcd_acked, frame, length);
+    if (boot_ticks == 0)
+    {
+        boot_ticks = uptime_ticks();
+    }
 
+    // A frame encoded before the latest change may have been the one that went out; catch the LCD up.
+    int i;
+    for (i = 0; i < TX_BYTES; i++)
+    {
+        if (lcd_acked[i] != tx_buffer[i])
+        {
+            scheduler_post(&scheduler, TASK_LCD_STATUS);
+            return true;
+        }
+    }
+    return false;
 }
 
-void start_ADC_conversion()
+void send_led_i2c()
 {
+    // One byte, one bit per LED. The slot coalesces, so a slow bus only ever skips to the newest bar state.
+    uint8_t frame = led_pattern_frame();
+    peripherals_post(PERIPHERAL_LED_BAR, LED_PATTERN_SLOT, &frame, 1);
+}
 
-    ADCCTL0 |= ADCENC | ADCSC;
+void send_log_frame()
+{
+    // The next frame goes out once the last one is acknowledged. If the host isn't there the frame is dropped after
+    // its retries and the readout stops; the next request starts it over.
+    if (!log_readout_active)
+    {
+        return;
+    }
 
+    uint8_t frame[TEMPERATURE_LOG_FRAME_MAX_LENGTH];
+    uint8_t length = temperature_log_frame(&log_readout, frame);
+    peripherals_post(PERIPHERAL_HOST, LOG_READOUT_SLOT, frame, length);
+    if (length == TEMPERATURE_LOG_FRAME_MAX_LENGTH - TEMPERATURE_LOG_FRAME_DATA)
+    {
+        log_readout_active = false; // That was the empty end frame
+    }
 }
 
-// Keypad data
-// 2D Array, each array is a row, each item is a column.
+char pass_code[] = "2659";
+char input_code[] = "0000";
 
-char keyPad[][4] = {{'1', '2', '3', 'A'},  // Top Row
-                    {'4', '5', '6', 'B'},
-                    {'7', '8', '9', 'C'},
-                    {'*', '0', '#', 'D'}}; // Bottom Row
-/*                    ^              ^
- *                    |              |
- *                    Left Column    Right Column
+/**
+ * Controller states. The values are what `state` held before these had names.
  */
+enum controller_state
+{
+    LOCKED,
+    UNLOCKING,
+    UNLOCKED,
+    SET_WINDOW,
+    SET_PATTERN,
+    STATE_COUNT
+};
 
-int column, row = 0;
+/**
+ * Screens the LCD can show, sent as tx_buffer[0].
+ */
+enum lcd_screen
+{
+    SCREEN_LOCKED,
+    SCREEN_SET_PATTERN,
+    SCREEN_SET_WINDOW,
+    SCREEN_DISPLAY_PATTERN
+};
 
-char key_pressed = '\0';
+struct power_stats power_stats;
+bool asleep = false;        // The main loop went into LPM; the next pass counts the wake-up
 
-char pass_code[] = "2659";
-char input_code[] = "0000";
+/**
+ * How much the 1 ms keypad scan timer runs. It is stopped whenever the keypad is idle, and restarted by the keypad's
+ * row interrupt.
+ */
+struct tick_stats
+{
+    /** Scan timer expiries */
+    uint32_t ticks_run;
 
-int mili_seconds_surpassed = 0;
+    /** Expiries that would have happened while it was stopped */
+    uint32_t ticks_avoided;
+};
+
+volatile struct tick_stats tick_stats;
+static uint32_t tick_stopped_at;    // uptime_ticks() when the scan timer was last stopped
 
 int index = 0;  // Which index of the above input_code array we're in
-int state = 0;  // State 0: Locked, State 1: Unlocking, State 2: Unlocked, State 3: Window Size Input, State 4: Pattern Input
+int state = LOCKED;
 int period = 0;
 
-unsigned int transition = 32768;
+unsigned int transition = LED_PATTERN_DEFAULT_PERIOD;  // LED pattern step period in wheel ticks
+uint8_t selected_pattern = LED_PATTERN_NONE;            // What the LED bar is running
 
-void get_temperature()
+void split_temperature()
+{
+    // Whole degrees carry the sign. The tenths come from the magnitude, so the LCD always gets a digit 0 - 9.
+    temperature_integer = board_temperature / 10;
+    temperature_decimal = abs(board_temperature) % 10;
+    tx_buffer[2] = temperature_integer;
+    tx_buffer[3] = temperature_decimal;
+}
+
+//---------------- Saved Settings ----------------
+// Settings and the last known state survive a reset in FRAM, see fram_record.h. Bump CONFIG_VERSION whenever
+// struct config changes, so an old record is ignored instead of misread.
+
+#define CONFIG_VERSION 1
+
+struct config
 {
+    uint8_t state;          // LOCKED or UNLOCKED; a code entry or open menu is saved as what it returns to
+    uint8_t pattern;        // selected_pattern
+    uint8_t window_size;
+    uint8_t reserved;
+    uint16_t transition;
+    int16_t temperature;    // Last reading, shown until the first new window completes
+};
+
+#pragma PERSISTENT(config_storage)
+static uint8_t config_storage[FRAM_RECORD_STORAGE(sizeof(struct config))] = {0};
+
+void save_config()
+{
+    // Called after anything in struct config may have changed; nothing is written if it didn't.
+    struct config config;
+    config.state = (state == LOCKED || state == UNLOCKING) ? LOCKED : UNLOCKED;
+    config.pattern = selected_pattern;
+    config.window_size = window_size;
+    config.reserved = 0;
+    config.transition = transition;
+    config.temperature = board_temperature;
+    fram_record_save(config_storage, CONFIG_VERSION, &config, sizeof(config));
+}
 
-    int i;
-    unsigned int total_adc_value = 0;
-    for (i = 1; i <= window_size; i++)
+void restore_config()
+{
+    // Runs before any peripheral is set up, so everything below starts from the restored values.
+    struct config config;
+    if (!fram_record_load(config_storage, CONFIG_VERSION, &config, sizeof(config)))
     {
+        return; // First boot or new layout, keep the defaults
+    }
 
-        total_adc_value += adc_results[i];
+    state = (config.state == UNLOCKED) ? UNLOCKED : LOCKED;
+    if (config.pattern <= LED_PATTERN_NONE)
+    {
+        selected_pattern = config.pattern;
+    }
+    if (config.window_size >= 1 && config.window_size <= 128)
+    {
+        window_size = config.window_size;
+    }
+    if (config.transition >= LED_PATTERN_DEFAULT_PERIOD / 8 && config.transition <= LED_PATTERN_DEFAULT_PERIOD)
+    {
+        transition = config.transition;
+    }
+    board_temperature = config.temperature;
 
+    tx_buffer[0] = (state == UNLOCKED) ? SCREEN_DISPLAY_PATTERN : SCREEN_LOCKED;
+    tx_buffer[1] = selected_pattern;
+    split_temperature();
+    tx_buffer[4] = window_size;
+}
+//---------------- End Saved Settings ----------------
+
+//---------------- Timers ----------------
+// Every periodic and one-shot job runs off the timer wheel on TB1 CCR0, see timer_wheel.h. Callbacks run in its ISR.
+
+bool keypad_timer_expired(void);
+struct soft_timer keypad_timer = SOFT_TIMER(keypad_timer_expired);
+
+void tick_stop()
+{
+    // Called from the scan callback once the keypad is idle.
+    timer_wheel_stop(&keypad_timer);
+    tick_stopped_at = uptime_ticks();
+}
+
+void tick_start()
+{
+    // Called from the PORT3 ISR on a key press. The first scan is a full period away.
+    if (timer_wheel_running(&keypad_timer))
+    {
+        return;
     }
 
-    unsigned int average_adc_value = total_adc_value / window_size;
-    float voltage = (average_adc_value / 4095.0) * REF_VOLTAGE;
-    float temperature = -1481.96 + sqrt(2.1962e6 + ((1.8639 - voltage) / (3.88e-6)));
-    temperature_integer = (int)temperature;
-    temperature *= 10.0;
-    temperature_decimal = (int)(temperature - temperature_integer);
-    tx_buffer[2] = temperature_integer;
-    tx_buffer[3] = temperature_decimal;
+    uint32_t elapsed = uptime_ticks() - tick_stopped_at;
+    tick_stats.ticks_avoided += (elapsed >> TIMER_WHEEL_SHIFT) / KEYPAD_SCAN_PERIOD;
+    timer_wheel_start(&keypad_timer, KEYPAD_SCAN_PERIOD, KEYPAD_SCAN_PERIOD);
+}
+
+bool keypad_timer_expired(void)
+{
+    // Never waits on a key, so ADC and I2C interrupts are not held off. Only wake the main loop for real events.
+    bool wake = false;
+    ISR_PROFILE_START();
+
+    if (keypad_scan())
+    {
+        scheduler_post(&scheduler, TASK_KEYS);
+        wake = true;
+    }
+
+    tick_stats.ticks_run++;
+    if (!keypad_scanning())
+    {
+        tick_stop(); // Nothing to time until the next key press
+    }
+
+    ISR_PROFILE_END(ISR_PROFILE_KEYPAD_TICK);
+    return wake;
+}
+
+bool unlock_timeout_expired(void)
+{
+    // A code that isn't finished in time is thrown away.
+    if (state != UNLOCKING)
+    {
+        return false;
+    }
+    state = LOCKED;
+    index = 0; // Reset position on input_code
+    tx_buffer[0] = SCREEN_LOCKED;
+#ifdef TELEMETRY
+    telemetry_state(state);
+#endif
+    scheduler_post(&scheduler, TASK_LCD_STATUS);
+    return true; // Let the main loop send the locked screen
+}
+
+bool heartbeat_expired(void)
+{
+    P1OUT ^= BIT0;  // Toggle P1.0 (LED1)
+    P6OUT ^= BIT6;  // Toggle P6.6 (LED2)
+    return false;
+}
+
+bool led_timer_expired(void)
+{
+    if (!led_pattern_step())
+    {
+        return false;
+    }
+    scheduler_post(&scheduler, TASK_LED_FRAME);
+    return true;
+}
 
-    if(state==2){
+struct soft_timer unlock_timer = SOFT_TIMER(unlock_timeout_expired);
+struct soft_timer heartbeat_timer = SOFT_TIMER(heartbeat_expired);
+struct soft_timer led_timer = SOFT_TIMER(led_timer_expired);
+//---------------- End Timers ----------------
+
+void set_window_size(int size)
+{
+    // Changing the window restarts the average, so old samples don't leak into the new window.
+    window_size = size;
+    adc_sampler_set_window(window_size);
+    tx_buffer[4] = window_size;
+}
+
+void get_temperature()
+{
+
+    // board_temperature was just converted by adc_sampler_update(), integer only, no soft-float
+    split_temperature();
+    temperature_log_add(board_temperature, uptime_whole_seconds());
+    save_config();
+
+    if(state == UNLOCKED){
         send_I2C_data();
     }
 }
 
-int main(void)
+//---------------- Key Actions ----------------
+// Each handler takes the key that was pressed and the argument from its table entry.
+
+void enter_code_digit(char key, uint8_t arg)
+{
+    (void)arg;
+
+    if (state != UNLOCKING)
+    {
+        timer_wheel_start(&unlock_timer, UNLOCK_TIMEOUT, 0); // Timed from the first digit
+    }
+    state = UNLOCKING; // Any key while locked starts a new code entry
+    input_code[index] = key; // Set the input code at index to what is pressed.
+
+    if(index >= 3){ // If we've entered all four digits of input code:
+        index = 0;
+        state = UNLOCKED; // Initially set state to free
+        timer_wheel_stop(&unlock_timer);
+        int i;
+        for(i = 0; i < 4; i++){ // Iterate through the pass_code and input_code
+            if(input_code[i] != pass_code[i]){ // If an element in pass_code and input_code doesn't match
+                state = LOCKED;                   // Set state back to locked.
+                break;
+            }
+        }
+        tx_buffer[0] = (state == UNLOCKED) ? SCREEN_DISPLAY_PATTERN : SCREEN_LOCKED;
+    }else{
+        index++; // Shift to next index of input code
+    }
+}
+
+void lock(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    state = LOCKED;
+    tx_buffer[0] = SCREEN_LOCKED;
+    tx_buffer[1] = 0;
+    transition = LED_PATTERN_DEFAULT_PERIOD;
+    led_pattern_set_period(transition);
+    selected_pattern = LED_PATTERN_NONE;
+    led_pattern_select(selected_pattern);
+}
+
+void prompt_window_size(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    state = SET_WINDOW;
+    tx_buffer[0] = SCREEN_SET_WINDOW;
+}
+
+void prompt_pattern(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    state = SET_PATTERN;
+    tx_buffer[0] = SCREEN_SET_PATTERN;
+}
+
+void change_led_speed(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    // Each press doubles the step rate, from 1 s down to 1/8 s, then wraps back to 1 s. The pattern keeps running.
+    transition >>= 1;
+    if (transition < LED_PATTERN_DEFAULT_PERIOD / 8)
+    {
+        transition = LED_PATTERN_DEFAULT_PERIOD;
+    }
+    led_pattern_set_period(transition);
+}
+
+void select_window_size(char key, uint8_t size)
+{
+    (void)key;
+
+    set_window_size(size);
+    state = UNLOCKED;
+    tx_buffer[0] = SCREEN_DISPLAY_PATTERN;
+}
+
+void select_pattern(char key, uint8_t pattern)
+{
+    (void)key;
+
+    tx_buffer[1] = pattern;
+    selected_pattern = pattern;
+    led_pattern_select(pattern);
+    state = UNLOCKED;
+    tx_buffer[0] = SCREEN_DISPLAY_PATTERN;
+}
+
+void start_log_readout(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    temperature_log_open(&log_readout);
+    log_readout_active = true;
+    send_log_frame();
+}
+
+#ifdef ISR_PROFILE
+void show_isr_profile(char key, uint8_t arg)
+{
+    (void)key;
+    (void)arg;
+
+    // Each press shows the next entry on the LCD; the LCD fills in its own entries. The press after the last one
+    // sends the empty entry, which puts the status screen back.
+    static uint8_t entry = 0;
+    uint8_t frame[ISR_PROFILE_FRAME_LENGTH];
+    uint8_t length = isr_profile_encode(frame, entry);
+    peripherals_post(PERIPHERAL_LCD, ISR_PROFILE_SLOT, frame, length);
+    entry = (entry < ISR_PROFILE_COUNT) ? entry + 1 : 0;
+}
+#endif
+
+/**
+ * What a key does in a given state.
+ */
+struct key_action
+{
+    /** Called with the key and arg, NULL if the key is ignored in this state */
+    void (*handler)(char key, uint8_t arg);
+
+    /** Passed through to the handler, e.g. the pattern or window size to select */
+    uint8_t arg;
+};
+
+// Every key feeds the pass code while locked or unlocking.
+#define CODE_ENTRY {enter_code_digit, 0}
+#define CODE_ENTRY_ROW {CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, \
+                        CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, \
+                        CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, \
+                        CODE_ENTRY, CODE_ENTRY, CODE_ENTRY, CODE_ENTRY}
+
+// Keys that do the same thing in every unlocked state.
+#define UNLOCKED_KEYS [KEY_A] = {prompt_window_size, 0}, \
+                      [KEY_B] = {prompt_pattern, 0},     \
+                      [KEY_C] = {change_led_speed, 0},   \
+                      [KEY_D] = {lock, 0}
+
+/**
+ * (state, key) -> action. Keys with no entry are ignored in that state.
+ */
+static const struct key_action key_actions[STATE_COUNT][KEYPAD_KEYS] = {
+    [LOCKED] = CODE_ENTRY_ROW,
+    [UNLOCKING] = CODE_ENTRY_ROW,
+    [UNLOCKED] = {
+        UNLOCKED_KEYS,
+        [KEY_HASH] = {start_log_readout, 0},    // Hidden, streams the temperature log to PERIPHERAL_HOST
+#ifdef ISR_PROFILE
+        [KEY_STAR] = {show_isr_profile, 0},     // Hidden diagnostics readout, see isr_profile.h
+#endif
+    },
+    [SET_WINDOW] = {
+        UNLOCKED_KEYS,
+        [KEY_0] = {select_window_size, 3},
+        [KEY_1] = {select_window_size, 1},
+        [KEY_2] = {select_window_size, 2},
+        [KEY_3] = {select_window_size, 3},
+        [KEY_4] = {select_window_size, 4},
+        [KEY_5] = {select_window_size, 5},
+        [KEY_6] = {select_window_size, 6},
+        [KEY_7] = {select_window_size, 7},
+        [KEY_8] = {select_window_size, 8},
+        [KEY_9] = {select_window_size, 9},
+        [KEY_STAR] = {select_window_size, 64},
+        [KEY_HASH] = {select_window_size, 128},
+    },
+    [SET_PATTERN] = {
+        UNLOCKED_KEYS,
+        [KEY_0] = {select_pattern, 0},
+        [KEY_1] = {select_pattern, 1},
+        [KEY_2] = {select_pattern, 2},
+        [KEY_3] = {select_pattern, 3},
+        [KEY_4] = {select_pattern, 4},
+        [KEY_5] = {select_pattern, 5},
+        [KEY_6] = {select_pattern, 6},
+        [KEY_7] = {select_pattern, 7},
+    },
+};
+
+void handle_key(const struct keypad_event *event)
+{
+    // Runs from the main loop for each debounced key press. One table lookup, no branch chain.
+    const struct key_action *action = &key_actions[state][event->index];
+
+    if (action->handler)
+    {
+#ifdef TELEMETRY
+        int was = state;
+#endif
+        bool was_locked = state == LOCKED || state == UNLOCKING;
+        action->handler(event->key, action->arg);
+        bool locked = state == LOCKED || state == UNLOCKING;
+
+#ifdef TELEMETRY
+        if (state != was)
+        {
+            telemetry_state(state);
+        }
+#endif
+
+        if (locked != was_locked)
+        {
+            broadcast_status();
+        }
+        else
+        {
+            send_I2C_data();
+        }
+        send_led_i2c();
+        save_config();
+    }
+}
+//---------------- End Key Actions ----------------
+
+//---------------- Tasks ----------------
+void run_keys(void)
+{
+    struct keypad_event event;
+    while (keypad_get_event(&event))
+    {
+        if (event.pressed)
+        {
+            handle_key(&event);
+        }
+    }
+}
+
+void run_temperature(void)
+{
+    ISR_PROFILE_START();
+    uint8_t updated = adc_sampler_update();
+    if (updated & (1 << BOARD_TEMPERATURE_CHANNEL))
+    {
+        get_temperature();
+    }
+    ISR_PROFILE_END(ISR_PROFILE_TEMPERATURE);
+
+#ifdef TELEMETRY
+    uint8_t i;
+    for (i = 0; i < ADC_CHANNEL_COUNT; i++)
+    {
+        if (updated & (1 << i))
+        {
+            telemetry_filtered(i, adc_channels[i].filtered, *adc_channels[i].report);
+        }
+    }
+#endif
+}
+
+#define TASK_DEADLINE_MS(ms) CLOCK_TICKS_US(UPTIME_TICKS_PER_SECOND, (ms) * 1000UL)
+
+// Deadlines are from the ISR's post to the end of the run. A key should show before the next press, frames before
+// the bus is next free to take them, and a reading well before the next one 0.5 s later.
+struct scheduler_task tasks[TASK_COUNT] = {
+    [TASK_KEYS] = {run_keys, TASK_DEADLINE_MS(20)},
+    [TASK_LCD_STATUS] = {send_I2C_data, TASK_DEADLINE_MS(10)},
+    [TASK_LED_FRAME] = {send_led_i2c, TASK_DEADLINE_MS(10)},
+    [TASK_TEMPERATURE] = {run_temperature, TASK_DEADLINE_MS(100)},
+    [TASK_LOG_READOUT] = {send_log_frame, TASK_DEADLINE_MS(50)},
+};
+//---------------- End Tasks ----------------
+
+void app_init(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
+    clock_init();               // CLOCK_MHZ profile, everything below is derived from it
+    uptime_init();              // TB1 counts ACLK from here, so boot_ticks covers everything below
+    scheduler_init(&scheduler, tasks, TASK_COUNT, uptime_ticks); // Before anything that can post
+    restore_config();           // Saved settings, before the peripherals they configure
 
     //---------------- Configure ADC ---------------
-    // Set P1.0 as ADC input
-    P1SEL0 |= BIT1;
-    P1SEL1 |= BIT1;
-
-    ADCCTL0 &= ~ADCSHT;
-    ADCCTL0 |= ADCSHT_2;
-    ADCCTL0 |= ADCON;
-    ADCCTL1 |= ADCSSEL_2;
-    ADCCTL1 |= ADCSHP;
-    ADCCTL2 &= ~ADCRES;
-    ADCCTL2 |= ADCRES_2;
-    ADCMCTL0 |= ADCINCH_1;
-    ADCIE |= ADCIE0;
+    // Every channel in adc_channels is converted on TB2.1 edges and oversampled 16x, see adc_sampler.h
+    adc_sampler_init(adc_channels, ADC_CHANNEL_COUNT, window_size);
     //---------------- End Configure ADC ------------
 
-    //---------------- Configure TB0 ----------------
-    TB0CTL |= TBCLR;            // Clear TB0 timer and dividers
-    TB0CTL |= TBSSEL__SMCLK;    // Select SMCLK as clock source
-    TB0CTL |= MC__UP;            // Choose UP counting
+#ifdef ISR_PROFILE
+    // TB0 only free-runs from SMCLK as the profiling time base, no interrupts.
+    TB0CTL = TBCLR;
+    TB0CTL |= TBSSEL__SMCLK | MC__CONTINUOUS;
 
-    TB0CCR0 = 1000;             // TTB0CCR0 = 1000, since 1/MHz * 1000 = 1 ms
-    TB0CCTL0 &= ~CCIFG;         // Clear CCR0 interrupt flag
-    TB0CCTL0 |= CCIE;           // Enable interrupt vector for CCR0
-
-    //---------------- End Configure TB0 ----------------
+    // An ISR that runs longer than the keypad scan period makes the next scan late. The temperature update runs from
+    // the main loop, but holds off key handling just the same.
+    isr_profile_init(&TB0R, 0);
+    isr_profile_set_budget(ISR_PROFILE_KEYPAD_TICK, KEYPAD_SCAN_CYCLES);
+    isr_profile_set_budget(ISR_PROFILE_ADC, KEYPAD_SCAN_CYCLES);
+    isr_profile_set_budget(ISR_PROFILE_TEMPERATURE, KEYPAD_SCAN_CYCLES);
+#endif
 
     //---------------- Configure P3 ----------------
-    // Configure P3 for digital I/O
-    P3SEL0 &= 0x00;
-    P3SEL1 &= 0x00;
-
-    P3DIR &= 0x0F;  // CLEARING bits 7 - 4, that way they are set to INPUT mode
-    P3DIR |= 0X0F;  // SETTING bits 0 - 3, that way they are set to OUTPUT mode
-
-    P3REN |= 0xF0;  // ENABLING the resistors for bits 7 - 4
-    P3OUT &= 0x00;  // CLEARING output register. This both clears our outputs on bits 0 - 3, and sets pull-down resistors
-                    // for bits 7 - 4
+    keypad_init();  // Columns on P3.3 - P3.0, rows on P3.7 - P3.4 with pull-downs
     //---------------- End Configure P3 ----------------
 
     //---------------- Configure LEDs ----------------
@@ -159,47 +738,35 @@ int main(void)
     //---------------- End Configure LEDs ----------------
 
     //---------------- Configure Timers ----------------
-    //LED Timer
-    TB1CTL |= TBCLR;
-    TB1CTL |= TBSSEL__ACLK;
-    TB1CTL |= MC__UP;
-    TB1CCR0 = 32768;
-    TB1CCTL0 |= CCIE;
-    TB1CCTL0 &= ~CCIFG;
-
-    //Temperature Sample Timer
-    TB2CTL |= TBCLR;
-    TB2CTL |= TBSSEL__ACLK;
-    TB2CTL |= MC__UP;
-    TB2CCR0 = 16384;
-
-    TB2CCTL0 |= CCIE;         //enable TB2 CCR0 Overflow IRQ
-    TB2CCTL0 &= ~CCIFG;       //clear CCR0 flag
+    // TB1 counts ACLK for uptime, started above. CCR0 runs the timer wheel, CCR1 and CCR2 the I2C retry backoff.
+    timer_wheel_init();
+
+    timer_wheel_start(&heartbeat_timer, HEARTBEAT_PERIOD, HEARTBEAT_PERIOD);
+    timer_wheel_start(&keypad_timer, KEYPAD_SCAN_PERIOD, KEYPAD_SCAN_PERIOD); // Stops itself once the keypad is idle
+
+    //LED Pattern Timer
+    led_pattern_init(&led_timer);
+    led_pattern_set_period(transition);
+    if (selected_pattern != LED_PATTERN_NONE)
+    {
+        led_pattern_select(selected_pattern);   // Saved pattern, restarted from its first step
+    }
+
+    //Temperature Sample Timer: TB2 is set up by adc_sampler_init() and triggers the ADC in hardware, no interrupt
     //---------------- End Timer Configure ---------------
 
+    // The pins are set up above, so let them out of their power-on lock. Before the I2C init, which reads SDA to spot a
+    // stuck bus, and PxIN reads nothing useful while the I/O is locked.
+    PM5CTL0 &= ~LOCKLPM5;       // Clear lock bit
+
     //---------------- Configure UCB0 I2C ----------------
 
     // Configure P1.2 (SDA) and P1.3 (SCL) for I2C
     P1SEL0 |= BIT2 | BIT3;
     P1SEL1 &= ~(BIT2 | BIT3);
 
-    // Put eUSCI_B0 into reset mode
-    UCB0CTLW0 = UCSWRST;
-
-    // Set as I2C master, synchronous mode, SMCLK source
-    UCB0CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
-
-    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
-    UCB0BRW = 10;
-
-    // Set slave address
-    UCB0I2CSA = LED_ADDRESS;
-
-    // Release reset state
-    UCB0CTLW0 &= ~UCSWRST;
-
-    // Enable transmit interrupt
-    UCB0IE |= UCTXIE0;
+    i2c_master_init(LCD_BUS, I2C_PRESCALER);
+    i2c_master_set_sent_handler(LCD_BUS, lcd_frame_sent);
     //---------------- End Configure UCB0 I2C ----------------
 
     //---------------- Configure UCB1 I2C ----------------
@@ -208,344 +775,147 @@ int main(void)
     P4SEL0 |= BIT6 | BIT7;
     P4SEL1 &= ~(BIT6 | BIT7);
 
-    // Put eUSCI_B0 into reset mode
-    UCB1CTLW0 = UCSWRST;
-
-    // Set as I2C master, synchronous mode, SMCLK source
-    UCB1CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
+    i2c_master_init(LED_BUS, I2C_PRESCALER);
+    //---------------- End Configure UCB1 I2C ----------------
 
-    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
-    UCB1BRW = 10;
+    peripherals_init(peripheral_table, PERIPHERAL_COUNT);
 
-    // Set slave address
-    UCB1I2CSA = LCD_ADDRESS;
+#ifdef TELEMETRY
+    //---------------- Configure UCA1 UART ----------------
+    // Raw samples, filtered values and state changes on P4.3, see telemetry.h
+    telemetry_init();
+    adc_sampler_set_sample_handler(telemetry_sample);
+    telemetry_state(state);     // Where the restored settings start from
+    //---------------- End Configure UCA1 UART ----------------
+#endif
 
-    // Release reset state
-    UCB1CTLW0 &= ~UCSWRST;
-
-    // Enable transmit interrupt
-    UCB1IE |= UCTXIE1;
-    //---------------- End Configure UCB0 I2C ----------------
+    temperature_log_init();
 
     send_I2C_data();
 
     __enable_interrupt();       // Enable Global Interrupts
-    PM5CTL0 &= ~LOCKLPM5;       // Clear lock bit
 
-    while(1) {}
-
-    return 0;
+    power_stats_init(&power_stats, uptime_ticks());
 }
 
-//-------------------------------------------------------------------------------
-// Interrupt Service Routines
-//-------------------------------------------------------------------------------
-
-//---------------- START ISR_TB0_SwitchColumn ----------------
-//-- TB0 CCR0 interrupt, read row data from column, shift roll read column right
-#pragma vector = TIMER0_B0_VECTOR
-__interrupt void ISR_TB0_SwitchColumn(void)
+void app_poll(void)
 {
-
-    if(state == 1){ // If in unlocking state
-        if(mili_seconds_surpassed >= 5000){
-            state = 0; // Set to lock state
-            index = 0; // Reset position on input_code
-            mili_seconds_surpassed = 0; // Reset timeout counter
-            tx_buffer[0] = 0;
-            //tx_buffer[2] = 0;
-            send_I2C_data();
-        }else{
-            mili_seconds_surpassed++;
-        }
+    // The pass after a sleep starts at the wake-up. Counted here rather than after the LPM entry, which returns
+    // straight away in the simulator.
+    if (asleep)
+    {
+        power_stats_wake(&power_stats, uptime_ticks());
+        asleep = false;
     }
 
-    switch (column) {
-        case 0:
-            P3OUT = 0b00001000; //Enable reading far left column
-            break;
-        case 1:
-            P3OUT = 0b00000100; // Enable reading center left column
-            break;
-        case 2:
-            P3OUT = 0b00000010; // Enable reading center right column
-            break;
-        default: // Case 3
-            P3OUT = 0b00000001; // Enable reading far right column
+    while (scheduler_run(&scheduler))
+    {
     }
 
-    if(P3IN > 15){  // If a button is being pressed
-
-        if(state == 0){ // If we're in the locked state, go to unlocking state.
-            state = 1;
-        }
-
-        if(P3IN & BIT4){    // If bit 4 is receiving input, we're at row 3, so on and so forth
-            row = 3;
-        }else if(P3IN & BIT5){
-            row = 2;
-        }else if(P3IN & BIT6){
-            row = 1;
-        }else if(P3IN & BIT7){
-            row = 0;
-        }
-
-        key_pressed = keyPad[row][column];
-
-        switch(state){
-
-            case 1: // If unlocking, we populate our input code with each pressed key
-                input_code[index] = key_pressed; // Set the input code at index to what is pressed.
-
-                if(index >= 3){ // If we've entered all four digits of input code:
-                    index = 0;
-                    state = 2; // Initially set state to free
-                    mili_seconds_surpassed = 0; // Stop lockout counter
-                    int i;
-                    for(i = 0; i < 4; i++){ // Iterate through the pass_code and input_code
-                        if(input_code[i] != pass_code[i]){ // If an element in pass_code and input_code doesn't match
-                            state = 0;                   // Set state back to locked.
-                            tx_buffer[0] = 0;
-                            break;
-                        }
-                    }
-                    tx_buffer[0] = 3;
-                    send_I2C_data();
-                }else{
-                    index++; // Shift to next index of input code
-                }
-
-                break;
-
-            default:     // If unlocked, we check the individual key press.
-                tx_buffer[0] = 3; // Display Pattern
-                switch(key_pressed){
-                    case('D'):
-                        state = 0; // Enter locked mode
-                        tx_buffer[0] = 0;
-                        tx_buffer[1] = 0;
-                        transition = 32768;
-                        led_index = 0;
-                        break;
-                    case('A'):
-                        state = 3;
-                        tx_buffer[0] = 2; // Set Window Size
-                        break;
-                    case('B'):
-                        state = 4;
-                        tx_buffer[0] = 1; // Set Pattern
-                        break;
-                    case('0'):      // Pattern 0
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 0; // Pattern 0
-                            led_index = 1;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 3;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-
-                        }
-                        break;
-                    case('1'):      // Pattern 1
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 1;
-                            led_index = 2;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 1;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('2'):      // Pattern 2
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 2;
-                            led_index = 3;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 2;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                                                }
-                        break;
-                    case('3'):      // Pattern 3
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 3;
-                            led_index = 4;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 3;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('4'):      // Pattern 4
-                        if (state == 4){
-                            tx_buffer[1] = 4;
-                            led_index = 5;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 4;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('5'):      // Pattern 5
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 5;
-                            led_index = 6;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 5;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('6'):      // Pattern 6
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 6;
-                            led_index = 7;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 6;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('7'):      // Pattern 7
-                        if (state == 4)
-                        {
-                            tx_buffer[1] = 4;
-                            led_index = 8;
-                            state = 2;
-                        }
-                        else if (state == 3)
-                        {
-                            window_size = 7;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('8'):
-                        if (state == 3)
-                        {
-                            window_size = 8;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                        break;
-                    case('9'):
-                        if (state == 3)
-                        {
-                            window_size = 9;
-                            state = 2;
-                            tx_buffer[4] = window_size;
-                        }
-                    default:
-                        break;
-                }
-                break;
-        }
-
-        while(P3IN > 15){} // Wait until button is released
-        send_I2C_data();
-
+    // Check for work and sleep with interrupts off, so a wake-up between the check and the sleep isn't lost.
+    // LPM0 rather than LPM3 because the keypad timer and both I2C modules run from SMCLK.
+    __disable_interrupt();
+    if (!scheduler_pending(&scheduler))
+    {
+        power_stats_sleep(&power_stats, uptime_ticks());
+        asleep = true;
+        __bis_SR_register(LPM0_bits | GIE);
     }
+    __enable_interrupt();
+}
 
-    if(P3IN < 16){ // Checks if pins 7 - 4 are on, that means a button is being held down; don't shift columns
-        if (++column >= 4) {column = 0;} // Add one to column, if it's 4 reset back to 0.
+#ifndef HAL_SIM
+int main(void)
+{
+    app_init();
+    while(1)
+    {
+        app_poll();
     }
-    TB0CCTL0 &= ~TBIFG;
+
+    return 0;
 }
-//---------------- End ISR_TB0_SwitchColumn ----------------
+#endif
+
+//-------------------------------------------------------------------------------
+// Interrupt Service Routines
+//-------------------------------------------------------------------------------
 
-//---------------- START ISR_TB1_Heartbeat ----------------
-// Heartbeat function
-#pragma vector = TIMER1_B0_VECTOR
-__interrupt void ISR_TB1_Heartbeat(void)
+//---------------- START ISR_Port3_KeypadWake ----------------
+//-- Row edge while the keypad is idle. Restarts scanning and the tick; the main loop is woken once a key debounces.
+HAL_ISR(PORT3_VECTOR, ISR_Port3_KeypadWake)
 {
-    P1OUT ^= BIT0;               //Toggle P1.0(LED1)
-    P6OUT ^= BIT6;               //Toggle P6.6(LED2)
-    TB1CCTL0 &= ~CCIFG;          //clear CCR0 flag
+    keypad_wake_isr();
+    tick_start();
 }
-//---------------- END ISR_TB1_Heartbeat ----------------
+//---------------- End ISR_Port3_KeypadWake ----------------
 
-//---------------- START ISR_TB2_CCR0 ----------------
-// Sample LM19 Temperature
-#pragma vector = TIMER2_B0_VECTOR
-__interrupt void ISR_TB2_CCR0(void)
+//---------------- START ISR_TB1_TimerWheel ----------------
+// Runs whatever software timers are due, see timer_wheel.h
+HAL_ISR(TIMER1_B0_VECTOR, ISR_TB1_TimerWheel)
 {
-    if (state == 2)
+    if (timer_wheel_isr())
     {
-        start_ADC_conversion();
+        __bic_SR_register_on_exit(LPM0_bits);
     }
-
-}
-
-#pragma vector = USCI_B0_VECTOR
-__interrupt void USCI_B0_ISR(void) {
-    if (UCB0IV == 0x18) { // TXIFG0 triggered
-            if (tx_index < TX_BYTES) {
-                UCB0TXBUF = tx_buffer[tx_index++]; // Load next byte
-            } else {
-                UCB0CTLW0 |= UCTXSTP; // Send stop condition
-                UCB0IE &= ~UCTXIE0;   // Disable TX interrupt after completion
-                tx_index = 0;
-            }
-        }
 }
+//---------------- END ISR_TB1_TimerWheel ----------------
 
-#pragma vector = USCI_B1_VECTOR
-__interrupt void USCI_B1_ISR(void) {
-    if (UCB1IV == 0x18) { // TXIFG0 triggered
-
-                UCB1TXBUF = led_buffer[led_index];
-                UCB1CTLW0 |= UCTXSTP; // Send stop condition
-                UCB1IE &= ~UCTXIE1;   // Disable TX interrupt after completion
+//---------------- START ISR_TB1_I2cRetry ----------------
+// I2C retry backoff, one TB1 compare channel per bus, and the uptime overflow
+HAL_ISR(TIMER1_B1_VECTOR, ISR_TB1_I2cRetry)
+{
+    bool wake = false;
+    switch (TB1IV)
+    {
+        case 0x02:  // CCR1
+            wake = i2c_master_timer_isr(LCD_BUS);
+            break;
+        case 0x04:  // CCR2
+            wake = i2c_master_timer_isr(LED_BUS);
+            break;
+        case 0x0E:  // TBIFG, counter wrapped
+            uptime_overflows++;
+            break;
+        default:
+            break;
+    }
 
-       }
+    if (wake)
+    {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
 }
+//---------------- END ISR_TB1_I2cRetry ----------------
 
-#pragma vector = ADC_VECTOR
-__interrupt void ADC_ISR(void) {
-    // Store the ADC result in the array
-    adc_results[sample_index] = ADCMEM0;
-    sample_index++;
-
-    // If we have collected window_size, calculate the average and reset the counter
-    if (sample_index >= window_size)
+HAL_ISR(USCI_B0_VECTOR, USCI_B0_ISR) {
+    if (i2c_master_isr(LCD_BUS))
     {
-
-        samples_collected = 1;
-        sample_index = 0;
-
+        __bic_SR_register_on_exit(LPM0_bits);
     }
+}
 
-    if (samples_collected == 1)
+HAL_ISR(USCI_B1_VECTOR, USCI_B1_ISR) {
+    if (i2c_master_isr(LED_BUS))
     {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
 
-        get_temperature();
+#ifdef TELEMETRY
+HAL_ISR(USCI_A1_VECTOR, USCI_A1_ISR) {
+    telemetry_isr();    // Never wakes the main loop
+}
+#endif
 
+HAL_ISR(ADC_VECTOR, ADC_ISR) {
+    // Most conversions only get accumulated here and the CPU goes straight back to sleep. The main loop is woken
+    // once a channel's filter has a full window, and converts and reports it from there.
+    ISR_PROFILE_START();
+    if (adc_sampler_isr())
+    {
+        scheduler_post(&scheduler, TASK_TEMPERATURE);
+        __bic_SR_register_on_exit(LPM0_bits);
     }
+    ISR_PROFILE_END(ISR_PROFILE_ADC);
 }
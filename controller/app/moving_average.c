@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @brief Constant-time moving average filter.
+ */
+
+#include "moving_average.h"
+
+void moving_average_init(struct moving_average *filter, uint8_t window_size)
+{
+    if (window_size < 1)
+    {
+        window_size = 1;
+    }
+    else if (window_size > MOVING_AVERAGE_MAX_WINDOW)
+    {
+        window_size = MOVING_AVERAGE_MAX_WINDOW;
+    }
+
+    int i;
+    for (i = 0; i < window_size; i++)
+    {
+        filter->samples[i] = 0;
+    }
+
+    filter->sum = 0;
+    filter->head = 0;
+    filter->count = 0;
+    filter->window_size = window_size;
+
+    // Work out the shift once here so the per-sample path never has to.
+    filter->shift = MOVING_AVERAGE_NO_SHIFT;
+    if ((window_size & (window_size - 1)) == 0)
+    {
+        filter->shift = 0;
+        while ((1 << filter->shift) < window_size)
+        {
+            filter->shift++;
+        }
+    }
+}
+
+void moving_average_push(struct moving_average *filter, uint16_t sample)
+{
+    // Slots are zeroed on init, so this is correct before the window fills too.
+    filter->sum -= filter->samples[filter->head];
+    filter->sum += sample;
+    filter->samples[filter->head] = sample;
+
+    if (++filter->head >= filter->window_size)
+    {
+        filter->head = 0;
+    }
+
+    if (filter->count < filter->window_size)
+    {
+        filter->count++;
+    }
+}
+
+bool moving_average_ready(const struct moving_average *filter)
+{
+    return filter->count >= filter->window_size;
+}
+
+uint16_t moving_average_value(const struct moving_average *filter)
+{
+    if (filter->shift != MOVING_AVERAGE_NO_SHIFT)
+    {
+        return (uint16_t)(filter->sum >> filter->shift);
+    }
+    return (uint16_t)(filter->sum / filter->window_size);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @brief Constant-time moving average filter.
+ *
+ * Keeps the last window_size samples in a ring buffer along with their running
+ * sum, so each new sample costs one add and one subtract no matter how large
+ * the window is. Power-of-two windows are averaged with a shift instead of a
+ * divide.
+ */
+
+#ifndef MOVING_AVERAGE_H
+#define MOVING_AVERAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOVING_AVERAGE_MAX_WINDOW 128
+
+/**
+ * Moving average state for one input signal.
+ */
+struct moving_average
+{
+    /** Ring buffer of the most recent samples */
+    uint16_t samples[MOVING_AVERAGE_MAX_WINDOW];
+
+    /** Sum of every sample currently in the ring buffer */
+    uint32_t sum;
+
+    /** Slot the next sample overwrites, which is also the oldest sample */
+    uint8_t head;
+
+    /** Number of samples pushed since init, saturating at window_size */
+    uint8_t count;
+
+    /** Number of samples averaged, 1 - MOVING_AVERAGE_MAX_WINDOW */
+    uint8_t window_size;
+
+    /** log2(window_size) if window_size is a power of two, otherwise MOVING_AVERAGE_NO_SHIFT */
+    uint8_t shift;
+};
+
+#define MOVING_AVERAGE_NO_SHIFT 0xFF
+
+/**
+ * Reset the filter and set its window size.
+ *
+ * @param: filter Filter to reset.
+ * @param: window_size Number of samples to average, clamped to 1 - MOVING_AVERAGE_MAX_WINDOW.
+ */
+void moving_average_init(struct moving_average *filter, uint8_t window_size);
+
+/**
+ * Add a sample, replacing the oldest one once the window is full.
+ *
+ * @param: filter Filter to update.
+ * @param: sample New sample.
+ */
+void moving_average_push(struct moving_average *filter, uint16_t sample);
+
+/**
+ * Check whether a full window of samples has been collected since init.
+ *
+ * @param: filter Filter to check.
+ *
+ * @return: true once window_size samples have been pushed.
+ */
+bool moving_average_ready(const struct moving_average *filter);
+
+/**
+ * Get the average of the samples in the window.
+ *
+ * @param: filter Filter to read.
+ *
+ * @return: Mean of the last window_size samples.
+ */
+uint16_t moving_average_value(const struct moving_average *filter);
+
+#endif // MOVING_AVERAGE_H
@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @brief Registry of the I2C nodes the controller drives.
+ */
+
+#include "peripherals.h"
+
+#define NO_ROUTE 0xFF
+
+// Address to send each kind of frame to on each bus: NO_ROUTE, the one node's address, or I2C_GENERAL_CALL.
+static uint8_t routes[PERIPHERAL_KIND_COUNT][I2C_BUS_COUNT];
+
+void peripherals_init(const struct peripheral *table, uint8_t count)
+{
+    uint8_t kind;
+    uint8_t bus;
+    for (kind = 0; kind < PERIPHERAL_KIND_COUNT; kind++)
+    {
+        for (bus = 0; bus < I2C_BUS_COUNT; bus++)
+        {
+            routes[kind][bus] = NO_ROUTE;
+        }
+    }
+    uint8_t i;
+    for (i = 0; i < count; i++)
+    {
+        const struct peripheral *node = &table[i];
+        uint8_t *route = &routes[node->kind][node->bus];
+
+        // A second node of the same kind on a bus turns its route into a general call.
+        *route = (*route == NO_ROUTE) ? node->address : I2C_GENERAL_CALL;
+    }
+}
+
+void peripherals_post(enum peripheral_kind kind, uint8_t slot, const uint8_t *data, uint8_t length)
+{
+    uint8_t bus;
+    for (bus = 0; bus < I2C_BUS_COUNT; bus++)
+    {
+        if (routes[kind][bus] != NO_ROUTE)
+        {
+            i2c_master_post((enum i2c_bus_id)bus, slot, routes[kind][bus], data, length);
+        }
+    }
+}
+
+void peripherals_broadcast(enum peripheral_kind kind, uint8_t slot, const uint8_t *data, uint8_t length)
+{
+    uint8_t bus;
+    for (bus = 0; bus < I2C_BUS_COUNT; bus++)
+    {
+        if (routes[kind][bus] != NO_ROUTE)
+        {
+            i2c_master_post((enum i2c_bus_id)bus, slot, I2C_GENERAL_CALL, data, length);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief Registry of the I2C nodes the controller drives.
+ *
+ * Each node is listed once with its kind, bus and address. Frames are sent to
+ * a kind of node rather than to an address: on a bus with one node of that
+ * kind the frame is addressed to it, and on a bus with several it goes out
+ * once as a general call (address 0x00) that every node on the bus receives.
+ * So fanning out to N nodes on a bus is one transaction, not N.
+ *
+ * peripherals_broadcast() general-calls every bus with a node of one kind,
+ * even a bus with only one, so every node of that kind takes the frame
+ * whatever address it was set to. Buses without that kind never see it, so
+ * e.g. a status keyframe stays off the LED bar's bus. Other kinds sharing a
+ * bus with it still receive the general call and must ignore frames they
+ * don't recognise.
+ */
+
+#ifndef PERIPHERALS_H
+#define PERIPHERALS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "i2c_master.h"
+
+/** Address every node with general call enabled answers to */
+#define I2C_GENERAL_CALL 0x00
+
+/**
+ * Kinds of node on the buses.
+ */
+enum peripheral_kind
+{
+    PERIPHERAL_LCD,
+    PERIPHERAL_LED_BAR,
+    PERIPHERAL_HOST,        // Bus adapter on a PC, only there to receive readouts
+    PERIPHERAL_KIND_COUNT
+};
+
+/**
+ * One node.
+ */
+struct peripheral
+{
+    enum peripheral_kind kind;
+
+    /** Bus the node is wired to */
+    enum i2c_bus_id bus;
+
+    /** 7-bit slave address, unique on its bus */
+    uint8_t address;
+};
+
+/**
+ * Work out how each kind of node is reached on each bus.
+ *
+ * @param: table Nodes. Only read during this call.
+ * @param: count Number of nodes.
+ */
+void peripherals_init(const struct peripheral *table, uint8_t count);
+
+/**
+ * Send a frame to every node of one kind, one transaction per bus.
+ *
+ * @param: kind Nodes to reach.
+ * @param: slot Frame slot on each bus, see i2c_master_post().
+ * @param: data Frame bytes, copied before returning.
+ * @param: length Number of bytes, 1 - I2C_MAX_FRAME.
+ */
+void peripherals_post(enum peripheral_kind kind, uint8_t slot, const uint8_t *data, uint8_t length);
+
+/**
+ * General-call a frame on every bus that has a node of one kind, one transaction per bus.
+ *
+ * @param: kind Nodes the frame is for. Buses without one are left alone.
+ * @param: slot Frame slot on each bus, see i2c_master_post().
+ * @param: data Frame bytes, copied before returning.
+ * @param: length Number of bytes, 1 - I2C_MAX_FRAME.
+ */
+void peripherals_broadcast(enum peripheral_kind kind, uint8_t slot, const uint8_t *data, uint8_t length);
+
+#endif // PERIPHERALS_H
@@ -0,0 +1,197 @@
+/**
+ * @file
+ * @brief Binary telemetry on the eUSCI_A1 UART, compiled in with TELEMETRY.
+ */
+
+#include "telemetry.h"
+
+#ifdef TELEMETRY
+
+#include "hal.h"
+#include "clock.h"
+#include "adc_sampler.h"
+#include "status_frame.h"
+#include "uptime.h"
+
+#define HEADER_LENGTH (TELEMETRY_FRAME_OVERHEAD - 1)    // Everything before the records
+
+// Every channel at full rate, three bytes a sample plus its share of the frame overhead, ten bits a byte on the wire.
+#define WORST_CASE_BITS_PER_SECOND (ADC_SAMPLER_MAX_CHANNELS * ADC_SAMPLER_RATE_HZ * 3UL \
+                                    * (TELEMETRY_FRAME_DATA + TELEMETRY_FRAME_OVERHEAD) / TELEMETRY_FRAME_DATA * 10)
+
+#if WORST_CASE_BITS_PER_SECOND * 4 > CLOCK_UART_BAUD
+#error "Raw samples at the ADC sampler's full rate would take over a quarter of the telemetry UART"
+#endif
+
+static uint8_t frames[2][HEADER_LENGTH + TELEMETRY_FRAME_DATA];
+static uint8_t filling = 0;         // Frame records are going into
+static uint8_t filled = 0;          // Record bytes in it so far
+static uint8_t sequence = 0;
+
+// The other frame, while the TX ISR sends it.
+static volatile bool sending = false;
+static bool flush_pending = false;  // telemetry_flush() came while sending, go again once it's done
+static const uint8_t *tx_next;
+static uint8_t tx_left;             // Bytes still to go, the CRC included
+static uint8_t tx_crc;
+
+volatile uint16_t telemetry_dropped = 0;
+
+static uint8_t crc_step(uint8_t crc, uint8_t byte)
+{
+    // status_frame_crc8() of one byte starts from 0, so feeding it crc ^ byte carries a running CRC on.
+    uint8_t in = crc ^ byte;
+    return status_frame_crc8(&in, 1);
+}
+
+// Interrupts off, nothing sending.
+static void send(void)
+{
+    uint8_t *frame = frames[filling];
+    frame[0] = TELEMETRY_FRAME_SYNC;
+    frame[1] = sequence++;
+    frame[2] = filled;
+
+    // The CRC is worked out byte by byte in the TX ISR, so a full frame costs the ADC ISR nothing extra.
+    tx_next = &frame[1];
+    tx_left = HEADER_LENGTH + filled;
+    tx_crc = crc_step(0, TELEMETRY_FRAME_SYNC);
+    sending = true;
+
+    // TXBUF is free whenever nothing is sending. The first byte starts the frame and TXIFG brings the rest.
+    UCA1TXBUF = TELEMETRY_FRAME_SYNC;
+    UCA1IE |= UCTXIE;
+
+    filling ^= 1;
+    filled = 0;
+}
+
+static void append(const uint8_t *record, uint8_t length)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (filled + length > TELEMETRY_FRAME_DATA)
+    {
+        if (!sending)
+        {
+            send();
+        }
+        else
+        {
+            // The other frame is still on the wire. This one is lost, but not its sequence number.
+            sequence++;
+            telemetry_dropped++;
+            filled = 0;
+        }
+    }
+
+    uint8_t *frame = frames[filling];
+    if (filled == 0)
+    {
+        uint32_t time = uptime_ticks();
+        frame[3] = time & 0xFF;
+        frame[4] = (time >> 8) & 0xFF;
+        frame[5] = (time >> 16) & 0xFF;
+        frame[6] = time >> 24;
+    }
+
+    uint8_t i;
+    for (i = 0; i < length; i++)
+    {
+        frame[HEADER_LENGTH + filled + i] = record[i];
+    }
+    filled += length;
+
+    __set_interrupt_state(interrupt_state);
+}
+
+void telemetry_init(void)
+{
+    // P4.3 as UCA1TXD, the LaunchPad's backchannel UART
+    P4SEL0 |= BIT3;
+    P4SEL1 &= ~BIT3;
+
+    UCA1CTLW0 = UCSWRST;                // Put eUSCI in reset
+    UCA1CTLW0 |= UCSSEL__SMCLK;         // UART 8N1, LSB first, from SMCLK
+    UCA1BRW = CLOCK_UART_BRW;           // CLOCK_UART_BAUD, see clock.h
+    UCA1MCTLW = CLOCK_UART_MCTLW;
+    UCA1CTLW0 &= ~UCSWRST;              // Release eUSCI from reset
+
+    filling = 0;
+    filled = 0;
+    sending = false;
+    flush_pending = false;
+}
+
+void telemetry_sample(uint8_t channel, uint16_t code)
+{
+    uint8_t record[3] = {TELEMETRY_SAMPLE | channel, code & 0xFF, code >> 8};
+    append(record, sizeof(record));
+}
+
+void telemetry_filtered(uint8_t channel, uint16_t code, int16_t reading)
+{
+    uint8_t record[5] = {TELEMETRY_FILTERED | channel, code & 0xFF, code >> 8,
+                         (uint16_t)reading & 0xFF, (uint16_t)reading >> 8};
+    append(record, sizeof(record));
+    telemetry_flush();
+}
+
+void telemetry_state(uint8_t state)
+{
+    uint8_t record[2] = {TELEMETRY_STATE, state};
+    append(record, sizeof(record));
+    telemetry_flush();
+}
+
+void telemetry_flush(void)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (filled && sending)
+    {
+        flush_pending = true;
+    }
+    else if (filled)
+    {
+        send();
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+void telemetry_isr(void)
+{
+    switch (UCA1IV)
+    {
+        case 0x04:  // UCTXIFG, TXBUF took the last byte
+            if (tx_left > 1)
+            {
+                uint8_t byte = *tx_next++;
+                tx_crc = crc_step(tx_crc, byte);
+                UCA1TXBUF = byte;
+                tx_left--;
+            }
+            else if (tx_left == 1)
+            {
+                UCA1TXBUF = tx_crc;
+                tx_left = 0;
+            }
+            else
+            {
+                // Frame done. The CRC may still be shifting out, but TXBUF is free for the next frame.
+                UCA1IE &= ~UCTXIE;
+                sending = false;
+                if (flush_pending && filled)
+                {
+                    send();
+                }
+                flush_pending = false;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+#endif // TELEMETRY
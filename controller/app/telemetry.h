@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief Binary telemetry on the eUSCI_A1 UART, compiled in with TELEMETRY.
+ *
+ * Streams every raw conversion the ADC sampler keeps, each filtered value it
+ * reports and every controller state change, so filter settings can be tuned
+ * from the real signal instead of the LCD's one decimal. TX is on P4.3, which
+ * the LaunchPad passes to the host as its backchannel UART, at CLOCK_UART_BAUD
+ * 8N1. Nothing is received.
+ *
+ * Records are packed into frames:
+ *
+ *     [0x7E] [sequence] [length] [time]... [records]... [CRC-8]
+ *
+ * length counts the record bytes, time is the 32-bit uptime_ticks() at the
+ * first record, and the status frame CRC covers every byte before it. Values
+ * are little-endian. Each record starts with a tag, type in the upper nibble
+ * and channel in the lower:
+ *
+ *     0x1c [code]                raw 12-bit conversion on channel c
+ *     0x2c [code] [reading]      filtered code and reported reading, e.g. deci-C
+ *     0x30 [state]               controller state changed
+ *
+ * There are two frame buffers and no DMA: records go into one while the
+ * UCA1 TX ISR sends the other. A frame goes out when it is full or on
+ * telemetry_flush(); a flush while the other frame is on the wire waits for
+ * it. A frame that fills up before the other is sent is dropped, but its
+ * sequence number is still used, so the host sees the gap. At
+ * ADC_SAMPLER_MAX_CHANNELS channels of ADC_SAMPLER_RATE_HZ the stream needs
+ * under a quarter of the link; telemetry.c checks that at compile time.
+ *
+ * Without the TELEMETRY predefined symbol telemetry.c is empty.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TELEMETRY_FRAME_SYNC 0x7E
+
+/** Record bytes per frame */
+#define TELEMETRY_FRAME_DATA 64
+
+/** Sync, sequence, length and time before the records, CRC after */
+#define TELEMETRY_FRAME_OVERHEAD 8
+
+#define TELEMETRY_SAMPLE 0x10
+#define TELEMETRY_FILTERED 0x20
+#define TELEMETRY_STATE 0x30
+
+#ifdef TELEMETRY
+
+/** Frames dropped because the previous one was still being sent */
+extern volatile uint16_t telemetry_dropped;
+
+/**
+ * Set up eUSCI_A1 as a UART on P4.3 and start with an empty frame.
+ */
+void telemetry_init(void);
+
+/**
+ * Record one raw conversion. An adc_sample_handler, so it runs in the ADC ISR.
+ *
+ * @param: channel Index into the ADC channel table.
+ * @param: code 12-bit conversion result.
+ */
+void telemetry_sample(uint8_t channel, uint16_t code);
+
+/**
+ * Record a channel's filtered value and send the frame.
+ *
+ * @param: channel Index into the ADC channel table.
+ * @param: code Filtered, oversampled code.
+ * @param: reading What it was converted to.
+ */
+void telemetry_filtered(uint8_t channel, uint16_t code, int16_t reading);
+
+/**
+ * Record a state change and send the frame. Safe from ISRs and the main loop.
+ *
+ * @param: state New controller state.
+ */
+void telemetry_state(uint8_t state);
+
+/**
+ * Send whatever is in the current frame, if anything. Safe from ISRs and the main loop.
+ */
+void telemetry_flush(void);
+
+/**
+ * Send the next byte of the frame on the wire. Call from the USCI_A1 ISR.
+ */
+void telemetry_isr(void);
+
+#endif // TELEMETRY
+
+#endif // TELEMETRY_H
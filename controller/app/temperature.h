@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief LM19 temperature conversion.
+ *
+ * Converts averaged ADC codes from the LM19 into deci-degrees Celsius
+ * using a lookup table and linear interpolation, so the ADC path never touches
+ * floating point or sqrt().
+ */
+
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+
+#include <stdint.h>
+
+/** Extra bits gained by 16x oversampling and decimation of the 12-bit ADC */
+#define TEMPERATURE_OVERSAMPLE_BITS 2
+
+/** Largest code temperature_from_adc() expects, i.e. 3.3 V */
+#define TEMPERATURE_ADC_MAX (4095 << TEMPERATURE_OVERSAMPLE_BITS)
+
+/**
+ * Convert an LM19 ADC code to temperature.
+ *
+ * @param: adc_code Oversampled ADC result (0 - TEMPERATURE_ADC_MAX), referenced to 3.3 V.
+ *
+ * @return: Temperature in tenths of a degree Celsius, e.g. 235 for 23.5 C.
+ */
+int16_t temperature_from_adc(uint16_t adc_code);
+
+#endif // TEMPERATURE_H
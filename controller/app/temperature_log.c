@@ -0,0 +1,284 @@
+/**
+ * @file
+ * @brief Temperature history in FRAM, with per-minute and per-hour aggregates.
+ */
+
+#include "hal.h"
+#include "status_frame.h"
+#include "fram_record.h"
+#include "temperature_log.h"
+
+#define MAGIC 0x7E01                // Changes whenever the layout in FRAM does
+#define BLOCK_SIZE sizeof(struct temperature_log_block)
+
+// Readout offsets are split into block and byte with a mask.
+typedef char block_size_is_64[(BLOCK_SIZE == 64) ? 1 : -1];
+
+/**
+ * Readings so far in the current minute or hour. RAM only.
+ */
+struct accumulator
+{
+    uint32_t period;    // Minute or hour number the readings belong to
+    int32_t sum;
+    uint16_t count;
+    int16_t min;
+    int16_t max;
+};
+
+/**
+ * Everything kept across resets.
+ */
+struct temperature_log_storage
+{
+    uint16_t magic;
+    uint8_t head;           // Block being appended to
+    uint8_t blocks;         // Blocks in use; the oldest is head - blocks + 1
+    uint32_t next_sample;   // Sequence number of the next sample
+
+    uint8_t minute_head;    // Next slot to write in minutes
+    uint8_t minute_count;
+    uint8_t hour_head;
+    uint8_t hour_count;
+    struct temperature_aggregate minutes[TEMPERATURE_LOG_MINUTES];
+    struct temperature_aggregate hours[TEMPERATURE_LOG_HOURS];
+
+    struct temperature_log_block block[TEMPERATURE_LOG_BLOCKS];
+};
+
+#pragma PERSISTENT(storage)
+static struct temperature_log_storage storage = {0};
+
+static struct accumulator minute;
+static struct accumulator hour;
+static bool block_open = false;     // Set once a block has been started since reset
+static int16_t last_sample;         // Deltas are taken from this, only valid while block_open
+
+static void summarise(const struct accumulator *accumulator, struct temperature_aggregate *aggregate)
+{
+    aggregate->min = accumulator->min;
+    aggregate->max = accumulator->max;
+    aggregate->mean = accumulator->sum / (int32_t)accumulator->count;
+}
+
+static bool accumulate(struct accumulator *accumulator, int16_t value, uint32_t period,
+                       struct temperature_aggregate *closed)
+{
+    // Returns true, with the finished period in closed, when value is the first reading of a new period.
+    bool closing = accumulator->count && period != accumulator->period;
+    if (closing)
+    {
+        summarise(accumulator, closed);
+        accumulator->count = 0;
+    }
+
+    if (accumulator->count == 0)
+    {
+        accumulator->period = period;
+        accumulator->sum = 0;
+        accumulator->min = value;
+        accumulator->max = value;
+    }
+    if (value < accumulator->min)
+    {
+        accumulator->min = value;
+    }
+    if (value > accumulator->max)
+    {
+        accumulator->max = value;
+    }
+    accumulator->sum += value;
+    accumulator->count++;
+    return closing;
+}
+
+static void push(struct temperature_aggregate *ring, uint8_t size, uint8_t *head, uint8_t *count,
+                 const struct temperature_aggregate *aggregate)
+{
+    ring[*head] = *aggregate;
+    *head = (*head + 1 < size) ? *head + 1 : 0;
+    if (*count < size)
+    {
+        *count = *count + 1;
+    }
+}
+
+static bool lookup(const struct temperature_aggregate *ring, uint8_t size, uint8_t head, uint8_t count,
+                   uint8_t ago, struct temperature_aggregate *aggregate)
+{
+    if (ago == 0 || ago > count)
+    {
+        return false;
+    }
+    *aggregate = ring[(head >= ago) ? head - ago : head + size - ago];
+    return true;
+}
+
+static void start_block(int16_t sample)
+{
+    // The new block is filled in before head moves onto it, and head moves before blocks counts it. When the
+    // ring is full next is the oldest block, still part of the log, so it is dropped from the count before any of
+    // it is overwritten. A reset between any two writes leaves a log that reads back in order, at worst one
+    // block short.
+    uint8_t next = storage.blocks ? storage.head + 1 : 0;
+    if (next >= TEMPERATURE_LOG_BLOCKS)
+    {
+        next = 0;
+    }
+    if (storage.blocks == TEMPERATURE_LOG_BLOCKS)
+    {
+        storage.blocks--;
+    }
+
+    struct temperature_log_block *block = &storage.block[next];
+    block->used = 0;
+    block->start = storage.next_sample;
+    block->first = sample;
+    block->flags = block_open ? 0 : TEMPERATURE_LOG_BOOT;
+
+    storage.head = next;
+    storage.blocks++;
+    block_open = true;
+}
+
+static void append(int16_t sample)
+{
+    struct temperature_log_block *block = &storage.block[storage.head];
+    int16_t delta = sample - last_sample;
+    bool fits_byte = delta > -128 && delta < 128;
+    uint8_t size = fits_byte ? 1 : 3;
+
+    fram_record_unlock();
+    if (!block_open || block->used + size > TEMPERATURE_LOG_BLOCK_DATA)
+    {
+        start_block(sample);
+    }
+    else
+    {
+        // Data first, then used, which is what makes it part of the log.
+        uint8_t used = block->used;
+        if (fits_byte)
+        {
+            block->data[used] = (uint8_t)delta;
+        }
+        else
+        {
+            block->data[used] = TEMPERATURE_LOG_ESCAPE;
+            block->data[used + 1] = (uint16_t)sample & 0xFF;
+            block->data[used + 2] = (uint16_t)sample >> 8;
+        }
+        block->used = used + size;
+    }
+    storage.next_sample++;
+    fram_record_lock();
+
+    last_sample = sample;
+}
+
+void temperature_log_init(void)
+{
+    if (storage.magic != MAGIC)
+    {
+        fram_record_unlock();
+        storage.head = 0;
+        storage.blocks = 0;
+        storage.next_sample = 0;
+        storage.minute_head = 0;
+        storage.minute_count = 0;
+        storage.hour_head = 0;
+        storage.hour_count = 0;
+        storage.magic = MAGIC;
+        fram_record_lock();
+    }
+
+    minute.count = 0;
+    hour.count = 0;
+    block_open = false;
+}
+
+void temperature_log_add(int16_t deci_celsius, uint32_t seconds)
+{
+    struct temperature_aggregate closed;
+
+    if (accumulate(&minute, deci_celsius, seconds / 60, &closed))
+    {
+        fram_record_unlock();
+        push(storage.minutes, TEMPERATURE_LOG_MINUTES, &storage.minute_head, &storage.minute_count, &closed);
+        fram_record_lock();
+        append(closed.mean);
+    }
+
+    if (accumulate(&hour, deci_celsius, seconds / 3600, &closed))
+    {
+        fram_record_unlock();
+        push(storage.hours, TEMPERATURE_LOG_HOURS, &storage.hour_head, &storage.hour_count, &closed);
+        fram_record_lock();
+    }
+}
+
+bool temperature_log_minute(uint8_t ago, struct temperature_aggregate *aggregate)
+{
+    if (ago == 0)
+    {
+        if (minute.count == 0)
+        {
+            return false;
+        }
+        summarise(&minute, aggregate);
+        return true;
+    }
+    return lookup(storage.minutes, TEMPERATURE_LOG_MINUTES, storage.minute_head, storage.minute_count, ago,
+                  aggregate);
+}
+
+bool temperature_log_hour(uint8_t ago, struct temperature_aggregate *aggregate)
+{
+    if (ago == 0)
+    {
+        if (hour.count == 0)
+        {
+            return false;
+        }
+        summarise(&hour, aggregate);
+        return true;
+    }
+    return lookup(storage.hours, TEMPERATURE_LOG_HOURS, storage.hour_head, storage.hour_count, ago, aggregate);
+}
+
+void temperature_log_open(struct temperature_log_cursor *cursor)
+{
+    uint8_t oldest = storage.head + 1 + TEMPERATURE_LOG_BLOCKS - storage.blocks;
+    cursor->block = (oldest >= TEMPERATURE_LOG_BLOCKS) ? oldest - TEMPERATURE_LOG_BLOCKS : oldest;
+    cursor->remaining = storage.blocks;
+    cursor->offset = 0;
+}
+
+uint8_t temperature_log_read(struct temperature_log_cursor *cursor, uint8_t *out, uint8_t length)
+{
+    uint8_t copied = 0;
+    while (copied < length && cursor->remaining)
+    {
+        const uint8_t *block = (const uint8_t *)&storage.block[cursor->block];
+        out[copied++] = block[cursor->offset & (BLOCK_SIZE - 1)];
+        cursor->offset++;
+
+        if ((cursor->offset & (BLOCK_SIZE - 1)) == 0)
+        {
+            cursor->remaining--;
+            cursor->block = (cursor->block + 1 < TEMPERATURE_LOG_BLOCKS) ? cursor->block + 1 : 0;
+        }
+    }
+    return copied;
+}
+
+uint8_t temperature_log_frame(struct temperature_log_cursor *cursor, uint8_t *frame)
+{
+    uint16_t offset = cursor->offset;
+    uint8_t length = temperature_log_read(cursor, &frame[3], TEMPERATURE_LOG_FRAME_DATA);
+
+    frame[0] = TEMPERATURE_LOG_FRAME_HEADER;
+    frame[1] = offset & 0xFF;
+    frame[2] = offset >> 8;
+    frame[3 + length] = status_frame_crc8(frame, 3 + length);
+    return length + 4;
+}
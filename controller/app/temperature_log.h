@@ -0,0 +1,163 @@
+/**
+ * @file
+ * @brief Temperature history in FRAM, with per-minute and per-hour aggregates.
+ *
+ * Every reading goes into a minute and an hour accumulator (min, max, sum),
+ * so the aggregates cost a few adds per reading and queries never read the
+ * log. When a minute closes its min / max / mean is kept in a ring of the last
+ * TEMPERATURE_LOG_MINUTES and its mean is appended to the log. Closed hours
+ * go in a ring of TEMPERATURE_LOG_HOURS.
+ *
+ * The log is a ring of fixed-size blocks. Each block starts with an absolute
+ * sample and holds signed one-byte deltas after it; a delta that doesn't fit
+ * is written as TEMPERATURE_LOG_ESCAPE followed by the absolute value, low
+ * byte first. Blocks are dropped whole when the ring wraps, so every block
+ * left can be decoded on its own. At one sample a minute and about one byte a
+ * sample, the 4 KB ring holds around two and a half days.
+ *
+ * Everything but the accumulators is in FRAM and survives a reset. Each write
+ * goes in before the count or index that publishes it, and a block the ring
+ * wraps onto leaves the count before it is overwritten, so a reset mid-update
+ * loses at most the sample being added and, on a wrap, one more old block.
+ * The first sample after a reset starts
+ * a new block marked TEMPERATURE_LOG_BOOT, as the time spent off is unknown.
+ *
+ * The log reads out as its blocks oldest first, each exactly as stored:
+ * struct temperature_log_block, little-endian. temperature_log_frame() cuts
+ * that into frames for a transport:
+ *
+ *     [TEMPERATURE_LOG_FRAME_HEADER] [offset] [data]... [CRC-8]
+ *
+ * with a 16-bit little-endian byte offset into the readout and the status
+ * frame CRC over every byte before it. A frame with no data ends the readout.
+ */
+
+#ifndef TEMPERATURE_LOG_H
+#define TEMPERATURE_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TEMPERATURE_LOG_BLOCKS 64
+#define TEMPERATURE_LOG_BLOCK_DATA 56   // Delta bytes per block, making each block 64 bytes
+#define TEMPERATURE_LOG_MINUTES 60
+#define TEMPERATURE_LOG_HOURS 72
+
+/** Marks an absolute sample in place of a delta */
+#define TEMPERATURE_LOG_ESCAPE ((uint8_t)0x80)
+
+/** Block flag: first block written after a reset */
+#define TEMPERATURE_LOG_BOOT 0x01
+
+#define TEMPERATURE_LOG_FRAME_HEADER 0xE1
+#define TEMPERATURE_LOG_FRAME_DATA 12
+#define TEMPERATURE_LOG_FRAME_MAX_LENGTH (TEMPERATURE_LOG_FRAME_DATA + 4)
+
+/**
+ * Min, max and mean over one minute or hour, in deci-degrees Celsius.
+ */
+struct temperature_aggregate
+{
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+};
+
+/**
+ * One block of the log, as stored and as read out.
+ */
+struct temperature_log_block
+{
+    /** Sequence number of the first sample, counting every sample since the log was formatted */
+    uint32_t start;
+
+    /** First sample, deci-degrees Celsius */
+    int16_t first;
+
+    /** Bytes of data in use */
+    uint8_t used;
+
+    /** TEMPERATURE_LOG_BOOT or 0 */
+    uint8_t flags;
+
+    /** Deltas from the previous sample, or TEMPERATURE_LOG_ESCAPE and an absolute sample */
+    uint8_t data[TEMPERATURE_LOG_BLOCK_DATA];
+};
+
+/**
+ * Position in a readout.
+ */
+struct temperature_log_cursor
+{
+    /** Block being read */
+    uint8_t block;
+
+    /** Blocks left, including this one */
+    uint8_t remaining;
+
+    /** Byte offset in the readout */
+    uint16_t offset;
+};
+
+/**
+ * Pick up the log left in FRAM, or format it if there is none.
+ */
+void temperature_log_init(void);
+
+/**
+ * Add a reading to the aggregates, closing the minute and hour when they change.
+ *
+ * @param: deci_celsius Reading in deci-degrees Celsius.
+ * @param: seconds Time of the reading, seconds since boot.
+ */
+void temperature_log_add(int16_t deci_celsius, uint32_t seconds);
+
+/**
+ * Get the aggregate for a minute.
+ *
+ * @param: ago 0 for the minute so far, 1 for the last complete minute, up to TEMPERATURE_LOG_MINUTES.
+ * @param: aggregate Output.
+ *
+ * @return: false if there is no reading for that minute.
+ */
+bool temperature_log_minute(uint8_t ago, struct temperature_aggregate *aggregate);
+
+/**
+ * Get the aggregate for an hour.
+ *
+ * @param: ago 0 for the hour so far, 1 for the last complete hour, up to TEMPERATURE_LOG_HOURS.
+ * @param: aggregate Output.
+ *
+ * @return: false if there is no reading for that hour.
+ */
+bool temperature_log_hour(uint8_t ago, struct temperature_aggregate *aggregate);
+
+/**
+ * Start a readout from the oldest block.
+ *
+ * @param: cursor Readout position to set up.
+ */
+void temperature_log_open(struct temperature_log_cursor *cursor);
+
+/**
+ * Copy out the next bytes of a readout.
+ *
+ * @param: cursor Readout position, advanced past the bytes copied.
+ * @param: out Output buffer.
+ * @param: length Largest number of bytes to copy.
+ *
+ * @return: Bytes copied, 0 once the readout is complete.
+ */
+uint8_t temperature_log_read(struct temperature_log_cursor *cursor, uint8_t *out, uint8_t length);
+
+/**
+ * Build the next readout frame.
+ *
+ * @param: cursor Readout position, advanced past the data sent.
+ * @param: frame Output buffer, at least TEMPERATURE_LOG_FRAME_MAX_LENGTH bytes.
+ *
+ * @return: Frame length. A frame with no data, 4 bytes, is the last one.
+ */
+uint8_t temperature_log_frame(struct temperature_log_cursor *cursor, uint8_t *frame);
+
+#endif // TEMPERATURE_LOG_H
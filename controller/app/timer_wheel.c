@@ -0,0 +1,323 @@
+/**
+ * @file
+ * @brief Software timers on one hardware compare channel, kept in a hierarchical timing wheel.
+ */
+
+#include "hal.h"
+#include "timer_wheel.h"
+#include "uptime.h"
+
+#define LEVEL_BITS 5
+#define SLOTS (1 << LEVEL_BITS)
+#define SLOT_MASK (SLOTS - 1)
+#define RANGE ((uint32_t)1 << (LEVEL_BITS * TIMER_WHEEL_LEVELS))    // Furthest expiry the wheel can hold
+
+#define SLOT_DUE 0xFE   // Taken off the wheel, about to be run by the ISR
+#define SLOT_IDLE 0xFF  // Not running
+
+// Wheel ticks carry on past the 27 bits uptime_ticks() leaves them, so the two are only compared as a difference.
+#define UPTIME_TICK_BITS (32 - TIMER_WHEEL_SHIFT)
+
+static struct soft_timer *slots[TIMER_WHEEL_LEVELS][SLOTS];
+static uint32_t occupied[TIMER_WHEEL_LEVELS];       // Bit n set while slots[level][n] holds a timer
+static uint32_t cascade_at[TIMER_WHEEL_LEVELS];     // Levels 1 up: next tick a non-empty slot moves down
+static uint32_t base;                               // Next tick not yet processed
+static uint8_t armed;                               // Timers on the wheel
+static bool processing = false;                     // In timer_wheel_isr(), which sets the compare at the end
+
+static uint32_t current_tick(void)
+{
+    // Sign-extended from 27 bits, so a tick that has only just been processed reads as a small negative lag.
+    uint32_t raw = (uptime_ticks() >> TIMER_WHEEL_SHIFT) - base;
+    int32_t lag = (int32_t)(raw << (32 - UPTIME_TICK_BITS)) >> (32 - UPTIME_TICK_BITS);
+    return base + lag;
+}
+
+static void link(struct soft_timer **head, struct soft_timer *timer)
+{
+    timer->next = *head;
+    if (*head)
+    {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void unlink(struct soft_timer *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if (timer->slot < SLOT_DUE)
+    {
+        uint8_t level = timer->slot >> LEVEL_BITS;
+        uint8_t index = timer->slot & SLOT_MASK;
+        if (!slots[level][index])
+        {
+            occupied[level] &= ~((uint32_t)1 << index);
+        }
+        armed--;
+    }
+    timer->slot = SLOT_IDLE;
+}
+
+static void insert(struct soft_timer *timer)
+{
+    uint32_t delta = timer->expires - base;
+    if ((int32_t)delta < 0)
+    {
+        timer->expires = base;  // Already late, run on the next tick processed
+        delta = 0;
+    }
+    if (delta >= RANGE)
+    {
+        delta = RANGE - 1;      // Parked, moved on when the top level comes round
+    }
+
+    uint8_t level = 0;
+    while (delta >= ((uint32_t)SLOTS << (LEVEL_BITS * level)))
+    {
+        level++;
+    }
+
+    uint8_t shift = LEVEL_BITS * level;
+    uint32_t at = base + delta;
+    uint8_t index = (at >> shift) & SLOT_MASK;
+
+    if (level > 0)
+    {
+        // The slot moves down at the start of its span, which is after base because delta covers a whole slot.
+        uint32_t cascade = at & ~(((uint32_t)1 << shift) - 1);
+        if (!occupied[level] || (int32_t)(cascade - cascade_at[level]) < 0)
+        {
+            cascade_at[level] = cascade;
+        }
+    }
+
+    link(&slots[level][index], timer);
+    occupied[level] |= (uint32_t)1 << index;
+    timer->slot = (level << LEVEL_BITS) | index;
+    armed++;
+}
+
+static bool next_event(uint32_t *tick)
+{
+    bool found = false;
+
+    // Level 0 holds the next SLOTS ticks from base, one slot each.
+    if (occupied[0])
+    {
+        uint8_t offset;
+        for (offset = 0; offset < SLOTS; offset++)
+        {
+            if (occupied[0] & ((uint32_t)1 << ((base + offset) & SLOT_MASK)))
+            {
+                *tick = base + offset;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    uint8_t level;
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (occupied[level] && (!found || (int32_t)(cascade_at[level] - *tick) < 0))
+        {
+            *tick = cascade_at[level];
+            found = true;
+        }
+    }
+    return found;
+}
+
+static void cascade(uint8_t level, uint32_t tick)
+{
+    uint8_t shift = LEVEL_BITS * level;
+    uint32_t span = tick >> shift;
+    struct soft_timer **head = &slots[level][span & SLOT_MASK];
+
+    // Everything in the slot expires within its span, so it all lands in lower levels.
+    while (*head)
+    {
+        struct soft_timer *timer = *head;
+        unlink(timer);
+        insert(timer);
+    }
+
+    if (occupied[level])
+    {
+        uint8_t offset = 1;
+        while (!(occupied[level] & ((uint32_t)1 << ((span + offset) & SLOT_MASK))))
+        {
+            offset++;
+        }
+        cascade_at[level] = (span + offset) << shift;
+    }
+}
+
+static bool process(uint32_t tick)
+{
+    bool wake = false;
+    base = tick;
+
+    uint8_t level;
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (tick & (((uint32_t)1 << (LEVEL_BITS * level)) - 1))
+        {
+            break;  // Not on a boundary of this level, so not of any above it either
+        }
+        if (occupied[level] && cascade_at[level] == tick)
+        {
+            cascade(level, tick);
+        }
+    }
+
+    // Take the slot's timers off before running any, so callbacks can start and stop timers freely.
+    struct soft_timer *due = 0;
+    struct soft_timer **head = &slots[0][tick & SLOT_MASK];
+    while (*head)
+    {
+        struct soft_timer *timer = *head;
+        unlink(timer);
+        link(&due, timer);
+        timer->slot = SLOT_DUE;
+    }
+    base = tick + 1;
+
+    while (due)
+    {
+        struct soft_timer *timer = due;
+        unlink(timer);
+        if (timer->period)
+        {
+            timer->expires += timer->period;
+            insert(timer);
+        }
+        if (timer->expired())
+        {
+            wake = true;
+        }
+    }
+    return wake;
+}
+
+static void reprogram(void)
+{
+    uint32_t next;
+    if (!next_event(&next))
+    {
+        TB1CCTL0 &= ~CCIE;
+        return;
+    }
+
+    // Only 16 bits of ACLK: an event more than 2 s out takes an early interrupt that finds nothing due.
+    TB1CCR0 = (uint16_t)(next << TIMER_WHEEL_SHIFT);
+    TB1CCTL0 &= ~CCIFG;
+    TB1CCTL0 |= CCIE;
+
+    // A compare set for a count TB1 has already passed won't match until it wraps; raise it by hand instead.
+    if ((int32_t)(next - current_tick()) <= 0)
+    {
+        TB1CCTL0 |= CCIFG;
+    }
+}
+
+void timer_wheel_init(void)
+{
+    uint8_t level;
+    uint8_t index;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        for (index = 0; index < SLOTS; index++)
+        {
+            slots[level][index] = 0;
+        }
+        occupied[level] = 0;
+    }
+    armed = 0;
+    base = uptime_ticks() >> TIMER_WHEEL_SHIFT;
+    TB1CCTL0 = 0;
+}
+
+void timer_wheel_start(struct soft_timer *timer, uint32_t delay, uint32_t period)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (timer->slot != SLOT_IDLE)
+    {
+        unlink(timer);
+    }
+
+    // An empty wheel isn't advanced, so catch base up before measuring from it.
+    if (!armed && !processing)
+    {
+        base = uptime_ticks() >> TIMER_WHEEL_SHIFT;
+    }
+
+    timer->expires = current_tick() + (delay ? delay : 1);
+    timer->period = period;
+    insert(timer);
+    if (!processing)
+    {
+        reprogram();
+    }
+
+    __set_interrupt_state(interrupt_state);
+}
+
+void timer_wheel_stop(struct soft_timer *timer)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (timer->slot != SLOT_IDLE)
+    {
+        unlink(timer);
+        if (!processing)
+        {
+            reprogram();
+        }
+    }
+
+    __set_interrupt_state(interrupt_state);
+}
+
+void timer_wheel_set_period(struct soft_timer *timer, uint32_t period)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    timer->period = period ? period : 1;
+    __set_interrupt_state(interrupt_state);
+}
+
+bool timer_wheel_running(const struct soft_timer *timer)
+{
+    return timer->slot != SLOT_IDLE;
+}
+
+bool timer_wheel_isr(void)
+{
+    bool wake = false;
+    uint32_t next;
+    processing = true;
+
+    // Checks the time again after each tick, so anything that came due while callbacks ran goes now.
+    while (next_event(&next) && (int32_t)(next - current_tick()) <= 0)
+    {
+        if (process(next))
+        {
+            wake = true;
+        }
+    }
+
+    processing = false;
+    reprogram();
+    return wake;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief Software timers on one hardware compare channel, kept in a hierarchical timing wheel.
+ *
+ * Every periodic or one-shot job on the controller is a struct soft_timer. The
+ * wheel counts in ticks of TIMER_WHEEL_SHIFT ACLK periods, about 1 ms, taken
+ * from uptime_ticks(), and has TIMER_WHEEL_LEVELS levels of 32 slots. Level 0
+ * slots are one tick apart, each level above covers 32 times the span of the
+ * one below. A timer goes into the lowest level that reaches its expiry, and
+ * moves down a level each time the wheel gets to its slot in the level above,
+ * so starting or stopping one is a fixed amount of work however many are
+ * running. Timers further out than the top level are parked in its last slot
+ * and moved on when it comes round.
+ *
+ * The wheel is tickless: TB1 CCR0 is set for the next tick at which a timer
+ * expires or a slot above level 0 has to be moved down, and ticks in between
+ * take no interrupt. With no timers running the compare interrupt is off.
+ *
+ * Expiry callbacks run in the TB1 CCR0 ISR, so they must be short and only
+ * hand work to the main loop. Periodic timers are re-armed from their expiry,
+ * not from when the ISR got to them, so the rate doesn't drift.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "clock.h"
+
+/** log2 of ACLK ticks per wheel tick */
+#define TIMER_WHEEL_SHIFT 5
+
+/** Wheel ticks per second */
+#define TIMER_WHEEL_HZ (CLOCK_ACLK_HZ >> TIMER_WHEEL_SHIFT)
+
+/** Wheel ticks in ms milliseconds, rounded up */
+#define TIMER_WHEEL_MS(ms) CLOCK_DIV_CEIL((uint32_t)(ms) * TIMER_WHEEL_HZ, 1000)
+
+/** Levels of 32 slots; four reach 2^20 ticks, about 17 minutes, before a timer is parked */
+#define TIMER_WHEEL_LEVELS 4
+
+/**
+ * Called from the TB1 CCR0 ISR when a timer expires.
+ *
+ * @return: true if the main loop needs to be woken.
+ */
+typedef bool (*soft_timer_callback)(void);
+
+/**
+ * One software timer. Set up with SOFT_TIMER() and leave the fields to the wheel.
+ */
+struct soft_timer
+{
+    struct soft_timer *next;
+    struct soft_timer **pprev;  // Whatever points at this timer, so it unlinks without knowing its slot
+
+    /** Wheel tick the timer expires on */
+    uint32_t expires;
+
+    /** Ticks between expiries, 0 for a one-shot */
+    uint32_t period;
+
+    soft_timer_callback expired;
+
+    /** Level * 32 + slot while running, or one of the markers in timer_wheel.c */
+    uint8_t slot;
+};
+
+/** Initialiser for a stopped timer */
+#define SOFT_TIMER(callback) {0, 0, 0, 0, (callback), 0xFF}
+
+/**
+ * Empty the wheel and take over TB1 CCR0. uptime_init() must have started TB1.
+ */
+void timer_wheel_init(void);
+
+/**
+ * Start a timer, or restart it if it is already running. Safe from ISRs and the main loop.
+ *
+ * @param: timer Timer to start.
+ * @param: delay Wheel ticks until the first expiry, at least 1; 0 is taken as 1.
+ * @param: period Wheel ticks between later expiries, or 0 for a one-shot.
+ */
+void timer_wheel_start(struct soft_timer *timer, uint32_t delay, uint32_t period);
+
+/**
+ * Stop a timer. Does nothing if it isn't running. Safe from ISRs and the main loop.
+ *
+ * @param: timer Timer to stop.
+ */
+void timer_wheel_stop(struct soft_timer *timer);
+
+/**
+ * Change the period of a periodic timer. The expiry already set is kept; the new period applies after it.
+ *
+ * @param: timer Timer to change.
+ * @param: period Wheel ticks between expiries, at least 1.
+ */
+void timer_wheel_set_period(struct soft_timer *timer, uint32_t period);
+
+/**
+ * Check whether a timer is running.
+ *
+ * @param: timer Timer to check.
+ *
+ * @return: true until a one-shot expires or the timer is stopped.
+ */
+bool timer_wheel_running(const struct soft_timer *timer);
+
+/**
+ * Run every timer that is due and set the compare for the next one. Call from the TB1 CCR0 ISR.
+ *
+ * @return: true if any expiry callback asked to wake the main loop.
+ */
+bool timer_wheel_isr(void);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,56 @@
+/**
+ * @file
+ * @brief Free-running timestamp for the controller.
+ */
+
+#include "hal.h"
+#include "uptime.h"
+
+volatile uint32_t uptime_overflows = 0;
+
+void uptime_init(void)
+{
+    TB1CTL = TBCLR;
+    TB1CTL |= TBSSEL__ACLK | MC__CONTINUOUS | TBIE;
+}
+
+// TB1 count and overflows, read consistently. Interrupts must be disabled.
+static uint32_t read_overflows(uint16_t *ticks)
+{
+    // TB1 runs from ACLK, asynchronous to MCLK, so read until two reads agree.
+    do
+    {
+        *ticks = TB1R;
+    }
+    while (*ticks != TB1R);
+
+    uint32_t overflows = uptime_overflows;
+
+    // The counter may have wrapped without the overflow ISR having run yet.
+    if ((TB1CTL & TBIFG) && *ticks < 0x8000)
+    {
+        overflows++;
+    }
+    return overflows;
+}
+
+uint32_t uptime_ticks(void)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    uint16_t ticks;
+    uint32_t overflows = read_overflows(&ticks);
+    __set_interrupt_state(interrupt_state);
+    return (overflows << 16) | ticks;
+}
+
+uint32_t uptime_whole_seconds(void)
+{
+    // Two seconds per overflow, and the top bit of the count is the odd one.
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    uint16_t ticks;
+    uint32_t overflows = read_overflows(&ticks);
+    __set_interrupt_state(interrupt_state);
+    return (overflows << 1) | (ticks >> 15);
+}
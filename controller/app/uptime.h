@@ -0,0 +1,44 @@
+/**
+ * @file
+ * @brief Free-running timestamp for the controller.
+ *
+ * TB1 counts ACLK (32768 Hz) continuously and its overflow interrupt extends
+ * it, giving a timestamp that keeps running in LPM0 - LPM3. TB1's compare
+ * channels are left to the timer wheel and the I2C retry backoff.
+ */
+
+#ifndef UPTIME_H
+#define UPTIME_H
+
+#include <stdint.h>
+#include "clock.h"
+
+#define UPTIME_TICKS_PER_SECOND CLOCK_ACLK_HZ
+
+/** TB1 overflows since boot, every 2 s, incremented by the TB1 overflow ISR */
+extern volatile uint32_t uptime_overflows;
+
+/**
+ * Start TB1 counting ACLK with the overflow interrupt enabled.
+ */
+void uptime_init(void);
+
+/**
+ * Current time since boot.
+ *
+ * Safe to call with interrupts enabled or disabled.
+ *
+ * @return: ACLK ticks since boot, wrapping after about 36 hours.
+ */
+uint32_t uptime_ticks(void);
+
+/**
+ * Whole seconds since boot, read atomically.
+ *
+ * Safe to call with interrupts enabled or disabled.
+ *
+ * @return: Seconds since boot, for timescales past uptime_ticks()' 36 hours.
+ */
+uint32_t uptime_whole_seconds(void);
+
+#endif // UPTIME_H
@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief Shadow framebuffer for the 2x16 HD44780.
+ */
+
+#include "framebuffer.h"
+#include "lcd.h"
+
+static char shadow[FRAMEBUFFER_ROWS][FRAMEBUFFER_COLUMNS]; // What the screen should show
+static char shown[FRAMEBUFFER_ROWS][FRAMEBUFFER_COLUMNS];  // What the panel is showing
+static uint16_t dirty[FRAMEBUFFER_ROWS];                   // Bit n set when cell n differs from the panel
+
+static const uint8_t row_address[FRAMEBUFFER_ROWS] = {0x00, LCD_LINE_2_ADDRESS};
+
+static void put_cell(uint8_t row, uint8_t column, char c)
+{
+    shadow[row][column] = c;
+
+    // Writing back what's already shown cancels an earlier change, e.g. clear then redraw the same text.
+    if (c != shown[row][column])
+    {
+        dirty[row] |= 1u << column;
+    }
+    else
+    {
+        dirty[row] &= ~(1u << column);
+    }
+}
+
+void framebuffer_init(void)
+{
+    int row, column;
+    for (row = 0; row < FRAMEBUFFER_ROWS; row++)
+    {
+        for (column = 0; column < FRAMEBUFFER_COLUMNS; column++)
+        {
+            shadow[row][column] = ' ';
+            shown[row][column] = ' ';
+        }
+        dirty[row] = 0;
+    }
+}
+
+void framebuffer_invalidate(void)
+{
+    int row, column;
+    for (row = 0; row < FRAMEBUFFER_ROWS; row++)
+    {
+        for (column = 0; column < FRAMEBUFFER_COLUMNS; column++)
+        {
+            shadow[row][column] = ' ';
+            shown[row][column] = '\0'; // Never drawn, so every cell stays dirty until it has been sent
+        }
+        dirty[row] = (uint16_t)((1UL << FRAMEBUFFER_COLUMNS) - 1);
+    }
+}
+
+void framebuffer_clear(void)
+{
+    int row, column;
+    for (row = 0; row < FRAMEBUFFER_ROWS; row++)
+    {
+        for (column = 0; column < FRAMEBUFFER_COLUMNS; column++)
+        {
+            put_cell(row, column, ' ');
+        }
+    }
+}
+
+void framebuffer_print(uint8_t row, uint8_t column, const char *str)
+{
+    if (row >= FRAMEBUFFER_ROWS)
+    {
+        return;
+    }
+
+    while (*str && column < FRAMEBUFFER_COLUMNS)
+    {
+        put_cell(row, column++, *str++);
+    }
+}
+
+void framebuffer_flush(void)
+{
+    int row;
+    for (row = 0; row < FRAMEBUFFER_ROWS; row++)
+    {
+        uint8_t column = 0;
+        while (dirty[row])
+        {
+            // Skip to the start of the next dirty run.
+            while (!(dirty[row] & (1u << column)))
+            {
+                column++;
+            }
+
+            // Need room for the address and at least one character, otherwise leave the rest for the next flush.
+            if (lcd_queue_space() < 2)
+            {
+                return;
+            }
+
+            // One address command per run, then the cursor auto-increments through it.
+            lcd_send_command(LCD_SET_DDRAM_ADDRESS | (row_address[row] + column));
+            while (column < FRAMEBUFFER_COLUMNS && (dirty[row] & (1u << column)) && lcd_queue_space() > 0)
+            {
+                lcd_send_data(shadow[row][column]);
+                shown[row][column] = shadow[row][column];
+                dirty[row] &= ~(1u << column);
+                column++;
+            }
+        }
+    }
+}
+
+bool framebuffer_dirty(void)
+{
+    return dirty[0] || dirty[1];
+}
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Shadow framebuffer for the 2x16 HD44780.
+ *
+ * Rendering writes characters into a RAM copy of the screen and nothing goes
+ * to the panel until framebuffer_flush(). Each cell whose character differs
+ * from what the panel currently shows is marked dirty, and a flush sends only
+ * the dirty runs, each preceded by one cursor-address command. An update that
+ * only changes the tenths digit costs one command and one character instead
+ * of a clear and a full redraw.
+ *
+ * The flush only queues bytes with the LCD driver. If the queue fills up, the
+ * cells that didn't fit stay dirty and go out on the next flush.
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAMEBUFFER_ROWS 2
+#define FRAMEBUFFER_COLUMNS 16
+
+/**
+ * Reset the shadow to match a freshly cleared panel (all spaces).
+ */
+void framebuffer_init(void);
+
+/**
+ * Forget what the panel shows, for one that kept its contents through a reset. The shadow is spaces and the next
+ * flush rewrites every cell, whatever is drawn before it.
+ */
+void framebuffer_invalidate(void);
+
+/**
+ * Fill the whole shadow with spaces.
+ */
+void framebuffer_clear(void);
+
+/**
+ * Write a string into the shadow, clipped at the end of the row.
+ *
+ * @param: row Row to write on, 0 or 1.
+ * @param: column Column of the first character, 0 - 15.
+ * @param: str Null terminated string.
+ */
+void framebuffer_print(uint8_t row, uint8_t column, const char *str);
+
+/**
+ * Queue every dirty run of cells for the panel, as far as the LCD queue has room.
+ */
+void framebuffer_flush(void);
+
+/**
+ * Check for cells that still need to be sent.
+ *
+ * @return: true if the shadow differs from the panel.
+ */
+bool framebuffer_dirty(void);
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief HD44780 driver, 4-bit bus on port 1.
+ */
+
+#include "hal.h"
+#include "clock.h"
+#include "lcd.h"
+
+#define DATA_PINS (D4 | D5 | D6 | D7)
+
+// Queue entries hold the byte in the low 8 bits and how to send it above that.
+#define ENTRY_DATA 0x100    // RS high, a character rather than a command
+#define ENTRY_NIBBLE 0x200  // Low nibble only, for the 8-bit mode wake-up sequence
+#define ENTRY_SLOW 0x400    // Clear and the wake-up codes need milliseconds before the next byte
+
+// TB0 runs from SMCLK / 8, which keeps the slow tick within 16 bits on every clock profile.
+#define TIMER_HZ (CLOCK_SMCLK_HZ / 8)
+#define TICK_FAST CLOCK_TICKS_US(TIMER_HZ, 50)      // Most commands and characters take 37 us
+#define TICK_SLOW CLOCK_TICKS_US(TIMER_HZ, 5000)    // Clear takes 1.52 ms, the first wake-up code 4.1 ms
+
+// Enable has to stay high at least 450 ns, which is more than one write at the faster clock profiles.
+#define E_PULSE_CYCLES CLOCK_CYCLES_NS(450)
+
+// D4 - D7 aren't contiguous on the port, so spread each nibble value onto its pins once, up front.
+static const uint8_t nibble_pins[16] = {
+    0,       D4,           D5,           D5 | D4,
+    D6,      D6 | D4,      D6 | D5,      D6 | D5 | D4,
+    D7,      D7 | D4,      D7 | D5,      D7 | D5 | D4,
+    D7 | D6, D7 | D6 | D4, D7 | D6 | D5, D7 | D6 | D5 | D4
+};
+
+static uint16_t queue[LCD_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0; // Written by the main loop only
+static volatile uint8_t queue_tail = 0; // Written by the TB0 ISR only
+static volatile bool timer_running = false;
+
+static void write_nibble(uint8_t nibble, uint8_t rs)
+{
+    // One masked write puts the nibble and RS on the bus together, then pulse enable so the LCD reads it.
+    PXOUT = (PXOUT & ~(DATA_PINS | RS)) | nibble_pins[nibble & 0x0F] | rs;
+    PXOUT |= E;         // Enable Enable pin
+    __delay_cycles(E_PULSE_CYCLES);
+    PXOUT &= ~E;        // Disable Enable pin
+}
+
+static bool queue_put(uint16_t entry)
+{
+    uint8_t head = queue_head;
+    if ((uint8_t)(head - queue_tail) >= LCD_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    queue[head & (LCD_QUEUE_SIZE - 1)] = entry;
+    queue_head = head + 1;
+
+    // Start the timer if it ran the queue dry. The first byte goes out one fast tick from now.
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (!timer_running)
+    {
+        timer_running = true;
+        TB0CCR0 = TB0R + TICK_FAST;
+        TB0CCTL0 &= ~CCIFG;
+        TB0CCTL0 |= CCIE;
+    }
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+bool lcd_send_command(char command){
+    return queue_put((uint8_t)command);
+}
+
+bool lcd_send_data(char data){
+    return queue_put(ENTRY_DATA | (uint8_t)data);
+}
+
+void lcd_print_sentence(char *str){
+    // Takes a string and queues it character by character until \0 is reached or the queue is full.
+    while(*str && lcd_send_data(*str)){
+        str++;
+    }
+}
+
+void lcd_clear(){
+    // Clearing the screen needs far longer than other commands, the timer waits it out instead of __delay_cycles.
+    queue_put(ENTRY_SLOW | 0x01);   // Clear display
+}
+
+static void timer_init(){
+    // TB0 counts SMCLK continuously; each byte schedules the next with CCR0.
+    TB0CTL = TBCLR;
+    TB0CTL |= TBSSEL__SMCLK | ID__8 | MC__CONTINUOUS;
+
+    PXOUT &= ~RS; // Explicitly set RS to 0 so we are in command mode
+}
+
+static void configure(){
+    lcd_send_command(0x28);   // Code 28h sets it to 2 line, 5x8 font.
+
+    lcd_send_command(0x0C);   // Turns display on, turns cursor off, turns blink off.
+
+    lcd_send_command(0x06);   // Increments cursor on each input
+}
+
+void lcdInit(){
+    // Initializes the LCD to 4 bit mode, 2 lines 5x8 font, with enabled display and cursor,
+    // clear the display, then set cursor to proper location.
+    timer_init();
+
+    // We need to send the code 3h, 3 times, to properly wake up the LCD screen
+    queue_put(ENTRY_SLOW | ENTRY_NIBBLE | 0x03);
+    queue_put(ENTRY_SLOW | ENTRY_NIBBLE | 0x03);
+    queue_put(ENTRY_SLOW | ENTRY_NIBBLE | 0x03);
+
+    queue_put(ENTRY_NIBBLE | 0x02);    // Code 2h sets it to 4-bit mode after waking up
+
+    configure();
+
+    lcd_clear();             // Clear display
+}
+
+void lcd_resume(){
+    // The panel is already in 4-bit mode, but a reset may have cut a byte off after its first nibble. Three 3h
+    // nibbles put it in 8-bit mode from either half, then 2h goes back to 4-bit, all without touching DDRAM.
+    timer_init();
+
+    // The first 3h may complete a half-sent byte as 03h, return home, which takes 1.52 ms.
+    queue_put(ENTRY_SLOW | ENTRY_NIBBLE | 0x03);
+    queue_put(ENTRY_NIBBLE | 0x03);
+    queue_put(ENTRY_NIBBLE | 0x03);
+    queue_put(ENTRY_NIBBLE | 0x02);
+
+    configure();
+}
+
+uint8_t lcd_queue_space(){
+    return LCD_QUEUE_SIZE - (uint8_t)(queue_head - queue_tail);
+}
+
+bool lcd_busy(){
+    return timer_running;
+}
+
+bool lcd_timer_isr(){
+    uint8_t tail = queue_tail;
+    if (tail == queue_head){
+        // Nothing left, stop interrupting until something is queued.
+        TB0CCTL0 &= ~CCIE;
+        timer_running = false;
+        return true;
+    }
+
+    uint16_t entry = queue[tail & (LCD_QUEUE_SIZE - 1)];
+    queue_tail = tail + 1;
+
+    uint8_t rs = (entry & ENTRY_DATA) ? RS : 0;
+    if (!(entry & ENTRY_NIBBLE)){
+        write_nibble(entry >> 4, rs); // Upper nibble first
+    }
+    write_nibble(entry, rs);
+
+    TB0CCR0 += (entry & ENTRY_SLOW) ? TICK_SLOW : TICK_FAST;
+    return false;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief HD44780 driver, 4-bit bus on port 1.
+ *
+ * D4 - D7 are on P1.0, P1.1, P1.4 and P1.5, E on P1.6 and RS on P1.7.
+ *
+ * Commands and characters are not written to the bus by the caller. They go
+ * into an output queue that the TB0 ISR drains one byte per tick, paced to
+ * the HD44780's execution times, so a whole screen can be queued and the
+ * caller returns immediately.
+ */
+
+#ifndef LCD_H
+#define LCD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Port definitions
+#define PXOUT P1OUT
+#define PXSEL0 P1SEL0
+#define PXSEL1 P1SEL1
+#define PXDIR P1DIR
+
+// Pin definitions
+#define D4 BIT0
+#define D5 BIT1
+#define D6 BIT4
+#define D7 BIT5
+
+#define E BIT6
+#define RS BIT7
+
+// Commands
+#define LCD_SET_DDRAM_ADDRESS 0x80  // OR in the address
+#define LCD_LINE_2_ADDRESS 0x40     // DDRAM address of line 2 position 1
+
+/** Output queue length in bytes, must be a power of two */
+#define LCD_QUEUE_SIZE 64
+
+/**
+ * Queue an 8-bit command.
+ *
+ * @return: false if the queue was full and the command was dropped.
+ */
+bool lcd_send_command(char command);
+
+/**
+ * Queue a character for the current cursor position.
+ *
+ * @return: false if the queue was full and the character was dropped.
+ */
+bool lcd_send_data(char data);
+
+/**
+ * Queue a string, stopping early if the queue fills.
+ */
+void lcd_print_sentence(char *str);
+
+/**
+ * Queue a clear display command.
+ */
+void lcd_clear();
+
+/**
+ * Set up the output timer and queue the wake-up and configuration sequence.
+ *
+ * Returns before the panel is initialized; anything queued afterwards is sent once it is.
+ */
+void lcdInit();
+
+/**
+ * Set up the output timer and queue a resync for a panel that kept power through a reset.
+ *
+ * Much shorter than lcdInit() and doesn't clear the display, so the last screen stays up until it is redrawn.
+ * Pair it with framebuffer_invalidate(), since the driver can't tell what the panel shows.
+ */
+void lcd_resume();
+
+/**
+ * Free space in the output queue.
+ *
+ * @return: Number of bytes that can be queued without dropping any.
+ */
+uint8_t lcd_queue_space();
+
+/**
+ * Check whether the output timer is still draining the queue.
+ *
+ * @return: true while there are bytes left to send. SMCLK has to stay on until this is false.
+ */
+bool lcd_busy();
+
+/**
+ * Send the next queued byte. Call from the TB0 CCR0 ISR.
+ *
+ * @return: true when this emptied the queue, so the main loop can refill it or go to a deeper sleep.
+ */
+bool lcd_timer_isr();
+
+#endif // LCD_H
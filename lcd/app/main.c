@@ -1,31 +1,60 @@
-#include <msp430.h> 
+#include "hal.h"
+#include "app.h"
+#include <stdbool.h>
+#include "clock.h"
+#include "uptime.h"
+#include "power_stats.h"
+#include "status_frame.h"
+#include "lcd.h"
+#include "framebuffer.h"
+#include "node_address.h"
+#include "isr_profile.h"
+#include "scheduler.h"
+#include "fram_record.h"
+
+struct power_stats power_stats;
+bool asleep = false;        // The main loop went into LPM; the next pass counts the wake-up
 
-// Port definitions
-#define PXOUT P1OUT
-#define PXSEL0 P1SEL0
-#define PXSEL1 P1SEL1
-#define PXDIR P1DIR
-
-// Pin definitions
-#define D4 BIT0
-#define D5 BIT1
-#define D6 BIT4
-#define D7 BIT5
-
-#define E BIT6
-#define RS BIT7
+typedef enum state_enum {LOCKED, SET_PATTERN, SET_WINDOW, DISPLAY_PATTERN};
 
-// I2C definitions
-#define ADDRESS 0x01    // Address for microcontroller
+typedef enum pattern_enum {STATIC, BREAK, UP_COUNTER, IN_AND_OUT, DOWN_COUNTER, ROTATE_1_LEFT, ROTATE_7_LEFT, FILL_LEFT};
 
-// LCD Variables
-int pattern_index, state_index = 0;
+// Received status, double buffered. The I2C ISR only ever writes frame_buffers[back_buffer] and the main loop only
+// renders frame_buffers[front_buffer]; the two are swapped with interrupts off when the main loop picks up a frame.
+uint8_t rx_fields[STATUS_FIELD_COUNT] = {LOCKED, 8, 0, 0, 0};  // Latest valid status, deltas are applied to this
+uint8_t frame_buffers[2][STATUS_FIELD_COUNT];
+uint8_t front_buffer = 0;
+uint8_t back_buffer = 1;
+volatile bool frame_received = false;   // frame_buffers[back_buffer] holds a frame that hasn't been rendered
+
+// Last rendered status, kept in FRAM so a reset comes back to the same screen and delta baseline. See fram_record.h.
+#define SCREEN_VERSION 1
+#pragma PERSISTENT(screen_storage)
+static uint8_t screen_storage[FRAM_RECORD_STORAGE(STATUS_FIELD_COUNT)] = {0};
+
+bool warm_boot = false;     // The panel kept power, so it was resynced and redrawn rather than initialized and cleared
+uint32_t boot_ticks = 0;    // uptime_ticks() when the first screen was completely on the panel, 0 until then
+
+// Work handed from ISRs to the main loop, highest priority first. See the task table above app_init().
+enum task{
+#ifdef ISR_PROFILE
+    TASK_PROFILE,   // A profile frame arrived
+#endif
+    TASK_RENDER,    // frame_received was set
+    TASK_FLUSH,     // The framebuffer changed or the LCD queue drained
+    TASK_COUNT
+};
+struct scheduler scheduler;
 
-int temperature_int, temperature_dec, window_size = 0;
+#ifdef ISR_PROFILE
+#define RX_FRAME_MAX_LENGTH ISR_PROFILE_FRAME_LENGTH    // Longer than any status frame
+#else
+#define RX_FRAME_MAX_LENGTH STATUS_FRAME_MAX_LENGTH
+#endif
 
-typedef enum state_enum {LOCKED, SET_PATTERN, SET_WINDOW, DISPLAY_PATTERN};
-
-typedef enum pattern_enum {STATIC, BREAK, UP_COUNTER, IN_AND_OUT, DOWN_COUNTER, ROTATE_1_LEFT, ROTATE_7_LEFT, FILL_LEFT};
+volatile unsigned int frames_rejected = 0;      // Frames dropped for a bad length, version or CRC
+volatile unsigned int frames_ignored = 0;       // General calls too short to be status frames, meant for other nodes
+volatile unsigned int frames_overwritten = 0;   // Frames replaced by a newer one before they were rendered
 
 char states_array[3][20] = {"", "Set Pattern", "Set Window Size"};
 
@@ -33,87 +62,71 @@ char patterns_array[9][20] = {
     "static", "break", "up counter", "in and out", "down counter", "rotate 1 left", "rotate 7 left", "fill left", ""
 };
 
-
-
-void lcd_pulse_enable(){
-    // Pulses the enable pin so LCD knows to take next nibble.
-    PXOUT |= E;         // Enable Enable pin
-    PXOUT &= ~E;        // Disable Enable pin
-}
-
-void lcd_send_nibble(char nibble){
-    // Sends out four bits to the LCD by setting the last four pins (D4 - 7) to the nibble.
-
-    PXOUT &= ~(D4 | D5 | D6 | D7); // Clear the out bits associated with our data lines.
-
-    // For each bit of the nibble, set the associated data line to it.
-    if (nibble & BIT0) PXOUT |= D4;
-    if (nibble & BIT1) PXOUT |= D5;
-    if (nibble & BIT2) PXOUT |= D6;
-    if (nibble & BIT3) PXOUT |= D7;
-
-    //PXOUT = (PXOUT &= 0xF0) | (nibble & 0x0F); // First we clear the first four bits, then we set them to the nibble.
-    lcd_pulse_enable();  // Pulse enable so LCD reads our input
-}
-
-void lcd_send_command(char command){
-    // Takes an 8-bit command and sends out the two nibbles sequentially.
-    PXOUT &= ~RS; // CLEAR RS to set to command mode
-    lcd_send_nibble(command >> 4); // Send upper nibble by bit shifting it to lower nibble
-    lcd_send_nibble(command & 0x0F); // Send lower nibble by clearing upper nibble.
-}
-
-void lcd_send_data(char data){
-    // Takes an 8-bit data and sends out the two nibbles sequentially.
-    PXOUT |= RS; // SET RS to set to data mode
-    lcd_send_nibble(data >> 4); // Send upper nibble by bit shifting it to lower nibble
-    lcd_send_nibble(data & 0x0F); // Send lower nibble by clearing upper nibble.
-}
-
-void lcd_print_sentence(char *str){
-    // Takes a string and iterates character by character, sending that character to be written out, until \0 is reached.
-    while(*str){
-        lcd_send_data(*str);
-        str++;
+#ifdef ISR_PROFILE
+// Profile readout, see isr_profile.h. Shown until the controller ends it or the screen (state) changes.
+struct isr_profile_summary rx_profile;      // Written by the I2C ISR
+bool showing_profile = false;
+uint8_t profile_state;                      // State field when the readout started
+
+char profile_names[ISR_PROFILE_COUNT][8] = {"tick", "adc", "temp", "i2c", "write"};
+
+char *format_number(char *out, uint16_t value){
+    // Decimal without leading zeros, returns the end of the digits.
+    char digits[5];
+    int count = 0;
+    do{
+        digits[count++] = (value % 10) + '0';
+        value /= 10;
+    }while(value);
+    while(count){
+        *out++ = digits[--count];
     }
+    *out = '\0';
+    return out;
 }
 
-void lcd_clear(){
-    // Clearing the screen is temperamental and requires a good delay, this is pretty arbitrary with a good safety margin.
-    lcd_send_command(0x01);   // Clear display
-    __delay_cycles(2000);   // Clear display needs some time, I'm aware __delay_cycles generally isn't advised, but it works in this context
-}
-
-void lcdInit(){
-    // Initializes the LCD to 4 bit mode, 2 lines 5x8 font, with enabled display and cursor,
-    // clear the display, then set cursor to proper location.
-
-    PXOUT &= ~RS; // Explicitly set RS to 0 so we are in command mode
-
-    // We need to send the code 3h, 3 times, to properly wake up the LCD screen
-    lcd_send_nibble(0x03);
-    lcd_send_nibble(0x03);
-    lcd_send_nibble(0x03);
-
-    lcd_send_nibble(0x02);    // Code 2h sets it to 4-bit mode after waking up
-
-    lcd_send_command(0x28);   // Code 28h sets it to 2 line, 5x8 font.
+void profile_write(const struct isr_profile_summary *received){
+    /*  Top line: entry name and overruns. Bottom line: min, mean and max in CPU cycles.
+        Entries this node times itself are shown from its own counters, the rest as the controller sent them.
+    */
+    struct isr_profile_summary summary = *received;
+    if (isr_profiles[summary.id].calls){
+        isr_profile_summarise(&summary, summary.id);
+    }
 
-    lcd_send_command(0x0C);   // Turns display on, turns cursor off, turns blink off.
+    char line[18];      // Three 5-digit numbers, two spaces and the NUL; framebuffer_print() clips to the panel
+    char *end;
 
-    lcd_send_command(0x06);   // Increments cursor on each input
+    framebuffer_clear();
 
-    lcd_clear();             // Clear display
+    end = line;
+    const char *name = profile_names[summary.id];
+    while(*name){
+        *end++ = *name++;
+    }
+    *end++ = ' ';
+    *end++ = 'o';
+    format_number(end, summary.overruns);
+    framebuffer_print(0, 0, line);
+
+    end = format_number(line, summary.min);
+    *end++ = ' ';
+    end = format_number(end, summary.mean);
+    *end++ = ' ';
+    format_number(end, summary.max);
+    framebuffer_print(1, 0, line);
 }
+#endif
 
-void lcd_write(){
+void lcd_write(const uint8_t *fields){
     /*  Ultimately dictates what will be present on screen after an I2C transmission.
-        I2C should come in five bytes, state_index, pattern_index, temperature_int, temperature_dec, and window_size.
+        fields holds the five status fields, state_index, pattern_index, temperature_int, temperature_dec, and
+        window_size, indexed by enum status_field.
         state_index -> Integer value corresponding to four states device can be in.
         State 0 = Locked. 1 = Set Pattern. 2 = Set Window. 3 = Display Pattern
         pattern_index -> Integer value corresponding to a pattern in patternArray. Pattern 0 is static, so index 0 is static.
         Pattern 8 is empty, and should be used when there is no pattern being displayed.
-        temperature_int -> Represents integer portion of temperature in Celsius.
+        temperature_int -> Represents integer portion of temperature in Celsius, signed.
         temperature_dec -> Represents decimal portion of temperature in Celsius
 
         In the locked state, the display should display nothing.
@@ -126,45 +139,152 @@ void lcd_write(){
         is selected. In this case, use the number 8 for the pattern index, as that corresponds to the empty "".
         This should be treated as the default unlocked state.
     */
-    lcd_clear(); // Clear Display
+    int state_index = fields[STATUS_FIELD_STATE];
+    int pattern_index = fields[STATUS_FIELD_PATTERN];
+    int temperature_int = (int8_t)fields[STATUS_FIELD_TEMP_INT];  // Signed; the tenths are always 0 - 9
+    int temperature_dec = fields[STATUS_FIELD_TEMP_DEC];
+
+    // Everything is drawn into the shadow framebuffer; the main loop's flush only sends cells that actually changed,
+    // so there is no clear (and no clear delay or flicker) on each frame.
+    framebuffer_clear();
 
     if (state_index == LOCKED){
         return;
     }
 
-    lcd_send_command(0x80); // Set cursor to line 1 position 1
-
     if (state_index == DISPLAY_PATTERN){
-        lcd_print_sentence(patterns_array[pattern_index]);
+        framebuffer_print(0, 0, patterns_array[pattern_index]);
     }else{
-        lcd_print_sentence(states_array[state_index]);
+        framebuffer_print(0, 0, states_array[state_index]);
     }
 
-    char temp_string[7]; // Buffer for converting int temp value to string
+    char temp_string[10]; // Buffer for converting int temp value to string
     int i = 0;
 
+    temp_string[i++] = 'T';
+    temp_string[i++] = '=';
+    if (temperature_int < 0){
+        temp_string[i++] = '-';
+        temperature_int = -temperature_int;
+    }
     temp_string[i++] = (temperature_int / 10) + '0';  // Tens place
     temp_string[i++] = (temperature_int % 10) + '0';  // Ones place
     temp_string[i++] = '.';
     temp_string[i++] = (temperature_dec % 10) + '0';  // First decimal place
     temp_string[i++] = 0b11011111; // Degrees symbol
     temp_string[i++] = 'C';
+    temp_string[i] = '\0';
 
+    framebuffer_print(1, 0, temp_string);
+    framebuffer_print(1, 15, "j");
+}
 
+#ifdef ISR_PROFILE
+void run_profile(void){
+    __disable_interrupt();
+    struct isr_profile_summary summary = rx_profile;
+    __enable_interrupt();
 
-    lcd_send_command(0xC0); // Set cursor to line 2 position 1
-    lcd_print_sentence("T=");
-    lcd_print_sentence(temp_string);
+    showing_profile = summary.id < ISR_PROFILE_COUNT;
+    if (showing_profile){
+        profile_state = frame_buffers[front_buffer][STATUS_FIELD_STATE];
+        profile_write(&summary);
+    }else{
+        lcd_write(frame_buffers[front_buffer]);
+    }
+    scheduler_post(&scheduler, TASK_FLUSH);
+}
+#endif
+
+void run_render(void){
+    // Swap so the ISR writes the next frame into the buffer we're done with, never the one being rendered.
+    __disable_interrupt();
+    front_buffer = back_buffer;
+    back_buffer ^= 1;
+    frame_received = false;
+    __enable_interrupt();
+
+#ifdef ISR_PROFILE
+    // Temperature updates don't end a readout, a new screen does.
+    if (showing_profile && frame_buffers[front_buffer][STATUS_FIELD_STATE] != profile_state){
+        showing_profile = false;
+    }
+    if (!showing_profile)
+#endif
+    {
+        ISR_PROFILE_START();
+        lcd_write(frame_buffers[front_buffer]);
+        ISR_PROFILE_END(ISR_PROFILE_LCD_WRITE);
+    }
+    scheduler_post(&scheduler, TASK_FLUSH);
 
-    lcd_send_command(0xCF); // Set cursor to line 2 position 16
-    lcd_print_sentence("j");
+    // Writes nothing unless the status changed.
+    fram_record_save(screen_storage, SCREEN_VERSION, frame_buffers[front_buffer], STATUS_FIELD_COUNT);
+}
 
-    lcd_send_command(0x80); // Return cursor to line 1 position 1
+void run_flush(void){
+    // Queue whatever changed. Anything that doesn't fit goes out after the queue drains and posts this again.
+    if (framebuffer_dirty() && !lcd_busy()){
+        framebuffer_flush();
+    }
+
+    // Posted again each time the queue drains, so the first time nothing is left is when the screen is up.
+    if (boot_ticks == 0 && !framebuffer_dirty() && !lcd_busy()){
+        boot_ticks = uptime_ticks();
+    }
 }
 
-int main(void)
+bool warm_reset(void){
+    // SYSRSTIV reads out each reset cause since the last read, then 0. The panel is on the same supply, so it only
+    // lost its contents if one of them was a brownout or supply fault. Bounded in case it never reads 0.
+    bool warm = true;
+    int i;
+    for (i = 0; i < 16; i++){
+        uint16_t cause = SYSRSTIV;
+        if (cause == SYSRSTIV_NONE){
+            break;
+        }
+        if (cause == SYSRSTIV_BOR || cause == SYSRSTIV_SVSHIFG){
+            warm = false;
+        }
+    }
+    return warm;
+}
+
+void restore_screen(void){
+    // Render the saved status as if it had just arrived. The controller's next frame is a delta against what it
+    // last saw acknowledged, which is this.
+    if (!fram_record_load(screen_storage, SCREEN_VERSION, rx_fields, STATUS_FIELD_COUNT)){
+        return;
+    }
+    int i;
+    for (i = 0; i < STATUS_FIELD_COUNT; i++){
+        frame_buffers[back_buffer][i] = rx_fields[i];
+    }
+    frame_received = true;
+    scheduler_post(&scheduler, TASK_RENDER);
+}
+
+#define TASK_DEADLINE_MS(ms) CLOCK_TICKS_US(UPTIME_TICKS_PER_SECOND, (ms) * 1000UL)
+
+// Deadlines are from the ISR's post to the end of the run. Key presses reach us a few ms apart, so a frame should
+// be rendered and queued well within that; a profile readout is only looked at.
+struct scheduler_task tasks[TASK_COUNT] = {
+#ifdef ISR_PROFILE
+    [TASK_PROFILE] = {run_profile, TASK_DEADLINE_MS(10)},
+#endif
+    [TASK_RENDER] = {run_render, TASK_DEADLINE_MS(2)},
+    [TASK_FLUSH] = {run_flush, TASK_DEADLINE_MS(2)},
+};
+
+void app_init(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
+    warm_boot = warm_reset();
+    clock_init();               // CLOCK_MHZ profile, shared with the controller through common/clock.h
+    uptime_init();              // TB1 counts ACLK from here, so boot_ticks covers everything below
+    scheduler_init(&scheduler, tasks, TASK_COUNT, uptime_ticks); // Before anything that can post
+    restore_screen();           // Rendered once the panel is set up below
 
     //---------------- Configure LCD Ports ----------------
 
@@ -185,61 +305,149 @@ int main(void)
 
     UCB0CTLW0 = UCSWRST;                 // Put eUSCI in reset
     UCB0CTLW0 |= UCMODE_3 | UCSYNC;      // I2C mode, synchronous mode
-    UCB0I2COA0 = ADDRESS | UCOAEN;       // Set slave address and enable
+    UCB0I2COA0 = node_address() | UCOAEN | UCGCEN; // Own address from info FRAM, plus general call broadcasts
     UCB0CTLW0 &= ~UCSWRST;               // Release eUSCI from reset
-    UCB0IE |= UCRXIE0;                   // Enable receive interrupt
+    UCB0IE |= UCRXIE0 | UCSTTIE | UCSTPIE; // Receive, plus START/STOP to frame each transmission
     //---------------- End Configure UCB0 I2C ----------------
 
     PM5CTL0 &= ~LOCKLPM5;       // Clear lock bit
     __bis_SR_register(GIE);     // Enable global interrupts
 
-    lcdInit();
+    if (warm_boot){
+        lcd_resume();               // Panel kept power and still shows the last screen; no 15 ms wake-up or clear
+        framebuffer_invalidate();   // Every cell is rewritten, with the same text if the screen was restored
+    }else{
+        lcdInit();          // Only queues the init sequence, TB0 sends it in the background
+        framebuffer_init(); // lcdInit() ends with a clear, which is what the shadow starts as
+    }
 
-    while(1){
+#ifdef ISR_PROFILE
+    // TB0 free-runs from SMCLK / 8 for the LCD output. The I2C ISR has to be done before the next byte arrives,
+    // about 90 us at 100 kHz, and lcd_write() before the shortest status frame after it, about 450 us.
+    isr_profile_init(&TB0R, 3);
+    isr_profile_set_budget(ISR_PROFILE_LCD_I2C, CLOCK_TICKS_US(CLOCK_SMCLK_HZ, 90));
+    isr_profile_set_budget(ISR_PROFILE_LCD_WRITE, CLOCK_TICKS_US(CLOCK_SMCLK_HZ, 450));
+#endif
+
+    power_stats_init(&power_stats, uptime_ticks());
+}
+
+void app_poll(void)
+{
+    // The pass after a sleep starts at the wake-up. Counted here rather than after the LPM entry, which returns
+    // straight away in the simulator.
+    if (asleep){
+        power_stats_wake(&power_stats, uptime_ticks());
+        asleep = false;
+    }
+
+    while (scheduler_run(&scheduler)){
+    }
 
+    // Check and sleep with interrupts off, so a frame finishing between the two isn't missed.
+    // LPM3 when idle: the I2C slave is clocked by the master and the uptime timer runs from ACLK.
+    // LPM0 while the LCD output timer, which runs from SMCLK, is still draining.
+    __disable_interrupt();
+    if (!scheduler_pending(&scheduler)){
+        power_stats_sleep(&power_stats, uptime_ticks());
+        asleep = true;
+        __bis_SR_register((lcd_busy() ? LPM0_bits : LPM3_bits) | GIE);
+    }
+    __enable_interrupt();
+}
+
+#ifndef HAL_SIM
+int main(void)
+{
+    app_init();
+    while(1){
+        app_poll();
     }
 
     return 0;
 }
+#endif
 
 //-------------------------------------------------------------------------------
 // Interrupt Service Routines
 //-------------------------------------------------------------------------------
 
-#pragma vector=USCI_B0_VECTOR
-__interrupt void USCI_B0_ISR(void) {
+HAL_ISR(USCI_B0_VECTOR, USCI_B0_ISR) {
     //ISR For receiving I2C transmissions
-    /* The microcontroller expects four bytes to be transmitted from the master.
-     * [state], [pattern], [temperature_int], [temperature_dec], [window_size]
-     * These bytes are sequentially added to the pattern_index, period_index, and key values.
+    /* Each transmission from the master is one status frame, see status_frame.h. START resets the receive buffer
+     * and STOP hands the bytes to status_frame_decode(), so a short or corrupted frame is dropped on its own and
+     * can't shift the bytes of the next one.
      *
-     * These values are then processed by lcd_write(), where more information can be found about their handling.
+     * A valid frame is applied to rx_fields, and the result copied into the back buffer for the main loop to render
+     * with lcd_write(), where more information can be found about their handling. Nothing here touches the buffer
+     * being rendered.
      */
-    static int byte_count = 0;
-    if(UCB0IV == 0x16){  // RXIFG0 Flag, RX buffer is full and can be processed
-        switch(byte_count){
-            case 0:
-                state_index = UCB0RXBUF;
-                break;
-            case 1:
-                pattern_index = UCB0RXBUF;
-                break;
-            case 2:
-                temperature_int = UCB0RXBUF;
-                break;
-            case 3:
-                temperature_dec = UCB0RXBUF;
-                break;
-            case 4:
-                window_size = UCB0RXBUF;
-                break;
-            default:
-                break;
-        }
-        byte_count++;
-        if(byte_count >= 5){
-            byte_count = 0;
-            lcd_write();
-        }
+    static uint8_t rx_frame[RX_FRAME_MAX_LENGTH];
+    static uint8_t rx_length = 0;
+    static bool rx_general_call = false;
+    ISR_PROFILE_START();
+
+    switch(UCB0IV){
+        case 0x06:  // STTIFG, START addressed to us or a general call
+            rx_length = 0;
+            rx_general_call = (UCB0STATW & UCGC) != 0;
+            break;
+        case 0x16:  // RXIFG0 Flag, RX buffer is full and can be processed
+            if (rx_length < RX_FRAME_MAX_LENGTH){
+                rx_frame[rx_length] = UCB0RXBUF;
+            }else{
+                (void)UCB0RXBUF; // Overlong, keep counting so decode rejects it
+            }
+            if (rx_length <= RX_FRAME_MAX_LENGTH){
+                rx_length++;
+            }
+            break;
+        case 0x08:  // STPIFG, frame complete
+#ifdef ISR_PROFILE
+            if (isr_profile_decode(&rx_profile, rx_frame, rx_length)){
+                scheduler_post(&scheduler, TASK_PROFILE);
+                __bic_SR_register_on_exit(LPM3_bits);
+            }else
+#endif
+            if (status_frame_decode(rx_fields, rx_frame, rx_length)){
+                if (frame_received){
+                    frames_overwritten++; // The display isn't keeping up; the newer frame wins
+                }
+                int i;
+                for (i = 0; i < STATUS_FIELD_COUNT; i++){
+                    frame_buffers[back_buffer][i] = rx_fields[i];
+                }
+                frame_received = true;
+                scheduler_post(&scheduler, TASK_RENDER);
+                __bic_SR_register_on_exit(LPM3_bits); // Render from the main loop, not from here
+            }else if (rx_general_call && rx_length < STATUS_FRAME_OVERHEAD){
+                frames_ignored++;   // e.g. an LED bar frame fanned out on a shared bus, not an error
+            }else{
+                frames_rejected++;
+            }
+            rx_length = 0;
+            break;
+        default:
+            break;
+    }
+    ISR_PROFILE_END(ISR_PROFILE_LCD_I2C);
+}
+
+HAL_ISR(TIMER0_B0_VECTOR, ISR_TB0_LcdOutput) {
+    // Sends one queued byte to the LCD per tick.
+    if (lcd_timer_isr()){
+        scheduler_post(&scheduler, TASK_FLUSH);
+        __bic_SR_register_on_exit(LPM3_bits); // Queue drained, let the main loop refill it or sleep deeper
+    }
+}
+
+HAL_ISR(TIMER1_B1_VECTOR, ISR_TB1_Overflow) {
+    // Extends the uptime timer to 32 bits. Doesn't wake the main loop.
+    switch(TB1IV){
+        case 0x0E:  // TBIFG, counter wrapped
+            uptime_overflows++;
+            break;
+        default:
+            break;
     }
 }
@@ -0,0 +1,23 @@
+/**
+ * @file
+ * @brief This node's I2C address, kept in info FRAM.
+ */
+
+#include "hal.h"
+#include "node_address.h"
+
+// Flashed as the default; tools/set_node_address.py rewrites it per unit in the TI-TXT image.
+#pragma LOCATION(configured_address, NODE_ADDRESS_LOCATION)
+const volatile uint8_t configured_address = NODE_ADDRESS_DEFAULT;
+
+uint8_t node_address(void)
+{
+    uint8_t address = configured_address;
+
+    // 0x00 is general call and anything over 0x7F isn't a 7-bit address, e.g. erased or never written
+    if (address == 0x00 || address > 0x7F)
+    {
+        return NODE_ADDRESS_DEFAULT;
+    }
+    return address;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief This node's I2C address, kept in info FRAM.
+ *
+ * The address lives in its own byte at NODE_ADDRESS_LOCATION rather than in
+ * the code, so one firmware image can be flashed to every LCD and each unit
+ * given its own address by patching that byte, see tools/set_node_address.py.
+ * General call is always accepted as well, for frames sent to every node.
+ */
+
+#ifndef NODE_ADDRESS_H
+#define NODE_ADDRESS_H
+
+#include <stdint.h>
+
+/** Start of info FRAM on the FR2310 */
+#define NODE_ADDRESS_LOCATION 0x1800
+
+/** Address used if the info FRAM byte doesn't hold a valid one */
+#define NODE_ADDRESS_DEFAULT 0x01
+
+/**
+ * Get the configured address.
+ *
+ * @return: 7-bit address, 0x01 - 0x7F.
+ */
+uint8_t node_address(void);
+
+#endif // NODE_ADDRESS_H
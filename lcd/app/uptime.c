@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @brief Free-running timestamp for the LCD node.
+ */
+
+#include "hal.h"
+#include "uptime.h"
+
+volatile uint16_t uptime_overflows = 0;
+
+void uptime_init(void)
+{
+    TB1CTL = TBCLR;
+    TB1CTL |= TBSSEL__ACLK | MC__CONTINUOUS | TBIE;
+}
+
+uint32_t uptime_ticks(void)
+{
+    uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    // TB1 runs from ACLK, asynchronous to MCLK, so read until two reads agree.
+    uint16_t ticks;
+    do
+    {
+        ticks = TB1R;
+    }
+    while (ticks != TB1R);
+
+    uint16_t overflows = uptime_overflows;
+
+    // The counter may have wrapped without the overflow ISR having run yet.
+    if ((TB1CTL & TBIFG) && ticks < 0x8000)
+    {
+        overflows++;
+    }
+
+    __set_interrupt_state(interrupt_state);
+    return ((uint32_t)overflows << 16) | ticks;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file
+ * @brief Free-running timestamp for the LCD node.
+ *
+ * TB1 counts ACLK (32768 Hz) continuously and its overflow interrupt extends
+ * it to 32 bits, giving a timestamp that keeps running in LPM3.
+ */
+
+#ifndef UPTIME_H
+#define UPTIME_H
+
+#include <stdint.h>
+#include "clock.h"
+
+#define UPTIME_TICKS_PER_SECOND CLOCK_ACLK_HZ
+
+/** TB1 overflows since boot, incremented by the TB1 overflow ISR */
+extern volatile uint16_t uptime_overflows;
+
+/**
+ * Start TB1 counting ACLK with the overflow interrupt enabled.
+ */
+void uptime_init(void);
+
+/**
+ * Current time since boot.
+ *
+ * Safe to call with interrupts enabled or disabled.
+ *
+ * @return: ACLK ticks since boot, wrapping after about 36 hours.
+ */
+uint32_t uptime_ticks(void);
+
+#endif // UPTIME_H
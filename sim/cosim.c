@@ -0,0 +1,722 @@
+/**
+ * @file
+ * @brief Two-node co-simulator: controller and LCD firmware on one virtual I2C bus.
+ *
+ * Loads each firmware, built with HAL_SIM as a shared object, with RTLD_LOCAL
+ * so each node keeps its own register file, and steps both in lockstep one
+ * ACLK tick at a time. The controller's eUSCI_B0 master is wired to the LCD's
+ * eUSCI_B0 slave, and its eUSCI_B1 bus ends in a stand-in LED bar that
+ * acknowledges its address and general calls and expects one pattern byte per
+ * frame. A model HD44780 watches the LCD node's port 1
+ * on every enable strobe and keeps the characters on screen.
+ *
+ * A script on stdin, or in the file given, drives the keypad and the LM19:
+ *
+ *     # comment
+ *     key 2659        press and release each key in turn
+ *     temp 23.5       set the LM19 temperature in Celsius
+ *     wait 500        let time pass, in milliseconds
+ *     screen          print what the LCD shows
+ *     host log.txt    attach a bus adapter at HOST_ADDRESS on the LCD bus that
+ *                     writes every frame it gets to the file, one hex line each
+ *     uart out.bin    write the controller's UART output to the file as is, for
+ *                     firmware built with TELEMETRY
+ *
+ * At the end it reports frames per second, key and temperature to display
+ * latency, I2C bytes per frame, each node's power_stats and scheduler task
+ * statistics. Firmware code takes no simulated time, so the active share only
+ * grows when a main loop stays awake across ticks; the wake-up count is what
+ * moves with interrupt load.
+ *
+ * It exits with status 1 if the LED bar was sent anything but pattern frames
+ * or NACKed anything, e.g. a status broadcast leaking onto its bus on lock or
+ * unlock.
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal_sim.h"
+#include "power_stats.h"
+#include "scheduler.h"
+
+#define TICKS_PER_SECOND 32768UL
+#define TICKS_MS(ms) ((uint32_t)((ms) * TICKS_PER_SECOND / 1000))
+
+#define KEY_HOLD_MS 40          // Well past KEYPAD_DEBOUNCE_SCANS at the 1 ms scan tick
+#define KEY_GAP_MS 40
+#define SETTLE_MS 2             // No HD44780 writes for this long and the screen counts as updated
+#define MAX_POLLS_PER_TICK 8    // Main loop passes per tick for a node that doesn't go back to sleep
+
+#define LCD_BUS 0               // Controller eUSCI_B0 -> LCD eUSCI_B0
+#define LED_BUS 1               // Controller eUSCI_B1 -> LED bar
+#define LED_BAR_ADDRESS 0x01
+#define GENERAL_CALL 0x00
+#define HOST_ADDRESS 0x30       // PERIPHERAL_HOST in controller/app/main.c
+
+// HD44780 DDRAM, line 1 starts at 0x40. 16x2 shows the first 16 cells of each line.
+#define LCD_COLUMNS 16
+#define LCD_DDRAM_SIZE 0x80
+#define LCD_LINE_2 0x40
+
+// Port 1 pins on the LCD node, see lcd/app/lcd.h.
+#define PIN_D4 BIT0
+#define PIN_D5 BIT1
+#define PIN_D6 BIT4
+#define PIN_D7 BIT5
+#define PIN_E BIT6
+#define PIN_RS BIT7
+
+/**
+ * One firmware image and the parts of its simulator interface we use.
+ */
+struct node
+{
+    const char *path;
+    void *handle;
+
+    void (*app_init)(void);
+    void (*app_poll)(void);
+    void (*step)(void);
+    bool (*sleeping)(void);
+    void (*set_step_hook)(void (*hook)(void));
+    void (*set_delay_hook)(void (*hook)(void));
+    void (*adc_set_input)(uint8_t input, uint16_t code);
+    void (*i2c_attach)(uint8_t bus, const struct hal_sim_i2c_device *device);
+    bool (*i2c_slave_start)(uint8_t bus, uint8_t address);
+    void (*i2c_slave_byte)(uint8_t bus, uint8_t data);
+    void (*i2c_slave_stop)(uint8_t bus);
+    void (*uart_set_tx_hook)(void (*hook)(uint8_t data));
+};
+
+/**
+ * Running min / max / mean of one measurement, in ticks.
+ */
+struct latency
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+};
+
+/**
+ * Traffic on one bus.
+ */
+struct bus_stats
+{
+    uint32_t frames;        // Acknowledged transactions
+    uint32_t nacked;        // Address phases nobody acknowledged
+    uint32_t bytes;         // Address and data bytes of acknowledged transactions
+    uint32_t frame_bytes;   // Bytes so far in the current transaction
+    uint32_t max_bytes;     // Longest transaction
+};
+
+static struct node controller = {.path = "./controller.so"};
+static struct node lcd = {.path = "./lcd.so"};
+static bool verbose = false;
+static uint32_t now = 0;
+
+static volatile uint8_t *keypad_out;    // Controller P3OUT, columns
+static volatile uint8_t *keypad_in;     // Controller P3IN, rows
+static int pressed_row = -1;
+static int pressed_column = -1;
+
+static volatile uint8_t *lcd_port;      // LCD node P1OUT
+
+static struct bus_stats lcd_bus;
+static struct bus_stats led_bus;
+
+static FILE *host_log;          // Bus adapter output, NULL while no adapter is attached
+static bool host_addressed;     // Current LCD bus transaction is for the adapter
+
+static FILE *uart_log;          // Controller UART output, NULL while not saved
+static uint32_t uart_bytes;
+
+static uint32_t led_stray_frames;   // LED bus frames that weren't one pattern byte
+
+static struct
+{
+    char ddram[LCD_DDRAM_SIZE];
+    uint8_t address;
+    bool four_bit;
+    bool low_nibble;        // Next strobe in 4-bit mode is the second half of a byte
+    uint8_t high;           // First half of the byte in progress
+    uint32_t last_write;    // Tick of the most recent strobe
+    uint32_t writes;        // Bytes written, commands and characters
+    char shown[2][LCD_COLUMNS + 1];  // Screen as of the last settled update
+    uint32_t updates;
+} hd44780;
+
+static uint32_t key_pressed_at;     // 0 when no key press is waiting to show up
+static uint32_t temp_changed_at;    // 0 when no temperature change is waiting to show up
+static struct latency key_latency;
+static struct latency temp_latency;
+
+static const char key_map[4][4] = {{'1', '2', '3', 'A'},
+                                   {'4', '5', '6', 'B'},
+                                   {'7', '8', '9', 'C'},
+                                   {'*', '0', '#', 'D'}};
+static const uint8_t column_drive[4] = {BIT3, BIT2, BIT1, BIT0};
+static const uint8_t row_sense[4] = {BIT7, BIT6, BIT5, BIT4};
+
+//---------------- Loading ----------------
+
+static void *symbol(struct node *node, const char *name)
+{
+    void *address = dlsym(node->handle, name);
+    if (!address)
+    {
+        fprintf(stderr, "%s: missing %s\n", node->path, name);
+        exit(1);
+    }
+    return address;
+}
+
+static void load(struct node *node)
+{
+    // RTLD_LOCAL keeps the two copies of hal_sim.c, and every register, apart.
+    node->handle = dlopen(node->path, RTLD_NOW | RTLD_LOCAL);
+    if (!node->handle)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(1);
+    }
+
+    *(void **)&node->app_init = symbol(node, "app_init");
+    *(void **)&node->app_poll = symbol(node, "app_poll");
+    *(void **)&node->step = symbol(node, "hal_sim_step");
+    *(void **)&node->sleeping = symbol(node, "hal_sim_sleeping");
+    *(void **)&node->set_step_hook = symbol(node, "hal_sim_set_step_hook");
+    *(void **)&node->set_delay_hook = symbol(node, "hal_sim_set_delay_hook");
+    *(void **)&node->adc_set_input = symbol(node, "hal_sim_adc_set_input");
+    *(void **)&node->i2c_attach = symbol(node, "hal_sim_i2c_attach");
+    *(void **)&node->i2c_slave_start = symbol(node, "hal_sim_i2c_slave_start");
+    *(void **)&node->i2c_slave_byte = symbol(node, "hal_sim_i2c_slave_byte");
+    *(void **)&node->i2c_slave_stop = symbol(node, "hal_sim_i2c_slave_stop");
+    *(void **)&node->uart_set_tx_hook = symbol(node, "hal_sim_uart_set_tx_hook");
+}
+
+//---------------- Keypad and LM19 ----------------
+
+static void keypad_step(void)
+{
+    // A held key connects its column to its row, so the row reads whatever the column is driven to.
+    uint8_t rows = 0;
+    if (pressed_row >= 0 && (*keypad_out & column_drive[pressed_column]))
+    {
+        rows = row_sense[pressed_row];
+    }
+    *keypad_in = rows;
+}
+
+static uint16_t lm19_code(double celsius)
+{
+    // LM19 transfer function from the datasheet, read by a 12-bit ADC against 3.3 V.
+    double volts = 1.8639 - 3.88e-6 * ((celsius + 1481.96) * (celsius + 1481.96) - 2.1962e6);
+    double code = volts / 3.3 * 4095.0 + 0.5;
+    return code < 0 ? 0 : code > 4095 ? 4095 : (uint16_t)code;
+}
+
+//---------------- HD44780 ----------------
+
+static void hd44780_byte(uint8_t value, bool data)
+{
+    hd44780.writes++;
+    if (data)
+    {
+        hd44780.ddram[hd44780.address] = (char)value;
+        hd44780.address = (hd44780.address + 1) & (LCD_DDRAM_SIZE - 1);
+    }
+    else if (value & 0x80)
+    {
+        hd44780.address = value & 0x7F;     // Set DDRAM address
+    }
+    else if (value == 0x01)
+    {
+        memset(hd44780.ddram, ' ', sizeof(hd44780.ddram));
+        hd44780.address = 0;
+    }
+    else if ((value & 0xFE) == 0x02)
+    {
+        hd44780.address = 0;                // Return home
+    }
+    else if ((value & 0xE0) == 0x20)
+    {
+        hd44780.four_bit = !(value & 0x10); // Function set, DL
+        hd44780.low_nibble = false;
+    }
+}
+
+static void hd44780_strobe(void)
+{
+    // Runs from the LCD node's __delay_cycles(), which only the enable pulse uses. E is high for the whole delay.
+    uint8_t port = *lcd_port;
+    if (!(port & PIN_E))
+    {
+        return;
+    }
+
+    uint8_t nibble = ((port & PIN_D4) ? 0x1 : 0) | ((port & PIN_D5) ? 0x2 : 0) |
+                     ((port & PIN_D6) ? 0x4 : 0) | ((port & PIN_D7) ? 0x8 : 0);
+    bool data = (port & PIN_RS) != 0;
+    hd44780.last_write = now;
+
+    if (!hd44780.four_bit)
+    {
+        // 8-bit mode, D0 - D3 aren't wired so they read as 0.
+        hd44780_byte(nibble << 4, data);
+    }
+    else if (!hd44780.low_nibble)
+    {
+        hd44780.high = nibble;
+        hd44780.low_nibble = true;
+    }
+    else
+    {
+        hd44780.low_nibble = false;
+        hd44780_byte((hd44780.high << 4) | nibble, data);
+    }
+}
+
+static void hd44780_line(int line, char *text)
+{
+    const char *cells = &hd44780.ddram[line ? LCD_LINE_2 : 0];
+    int i;
+    for (i = 0; i < LCD_COLUMNS; i++)
+    {
+        unsigned char c = (unsigned char)cells[i];
+        text[i] = (c == 0xDF) ? '\'' : (c >= ' ' && c < 0x7F) ? (char)c : '?';  // 0xDF is the degree sign
+    }
+    text[LCD_COLUMNS] = '\0';
+}
+
+static void print_screen(void)
+{
+    printf("[%9.4f s] |%s|\n", now / (double)TICKS_PER_SECOND, hd44780.shown[0]);
+    printf("             |%s|\n", hd44780.shown[1]);
+}
+
+static void record(struct latency *latency, uint32_t ticks)
+{
+    if (latency->count == 0 || ticks < latency->min)
+    {
+        latency->min = ticks;
+    }
+    if (ticks > latency->max)
+    {
+        latency->max = ticks;
+    }
+    latency->total += ticks;
+    latency->count++;
+}
+
+static void hd44780_settle(void)
+{
+    // An update is several writes one LCD tick apart; call it done once the bus has been quiet for SETTLE_MS,
+    // and date it by its last write so the quiet period isn't counted as latency.
+    if (now - hd44780.last_write < TICKS_MS(SETTLE_MS))
+    {
+        return;
+    }
+
+    char line[2][LCD_COLUMNS + 1];
+    hd44780_line(0, line[0]);
+    hd44780_line(1, line[1]);
+    bool top_changed = strcmp(line[0], hd44780.shown[0]) != 0;
+    bool bottom_changed = strcmp(line[1], hd44780.shown[1]) != 0;
+    if (!top_changed && !bottom_changed)
+    {
+        return;
+    }
+
+    memcpy(hd44780.shown, line, sizeof(line));
+    hd44780.updates++;
+
+    if (key_pressed_at)
+    {
+        record(&key_latency, hd44780.last_write - key_pressed_at);
+        key_pressed_at = 0;
+    }
+    if (temp_changed_at && bottom_changed)
+    {
+        record(&temp_latency, hd44780.last_write - temp_changed_at);
+        temp_changed_at = 0;
+    }
+    if (verbose)
+    {
+        print_screen();
+    }
+}
+
+//---------------- I2C ----------------
+
+static void bus_start(struct bus_stats *bus)
+{
+    bus->frame_bytes = 1;   // Address byte
+}
+
+static void bus_stop(struct bus_stats *bus)
+{
+    bus->frames++;
+    bus->bytes += bus->frame_bytes;
+    if (bus->frame_bytes > bus->max_bytes)
+    {
+        bus->max_bytes = bus->frame_bytes;
+    }
+}
+
+static bool lcd_bus_start(void *context, uint8_t address)
+{
+    (void)context;
+    host_addressed = host_log && address == HOST_ADDRESS;
+    if (host_addressed)
+    {
+        bus_start(&lcd_bus);
+        return true;
+    }
+    if (!lcd.i2c_slave_start(LCD_BUS, address))
+    {
+        lcd_bus.nacked++;
+        return false;
+    }
+    bus_start(&lcd_bus);
+    return true;
+}
+
+static void lcd_bus_byte(void *context, uint8_t data)
+{
+    (void)context;
+    lcd_bus.frame_bytes++;
+    if (host_addressed)
+    {
+        fprintf(host_log, "%02x ", data);
+        return;
+    }
+    lcd.i2c_slave_byte(LCD_BUS, data);
+}
+
+static void lcd_bus_stop(void *context)
+{
+    (void)context;
+    bus_stop(&lcd_bus);
+    if (host_addressed)
+    {
+        fputc('\n', host_log);
+        return;
+    }
+    lcd.i2c_slave_stop(LCD_BUS);
+}
+
+static void uart_byte(uint8_t data)
+{
+    uart_bytes++;
+    if (uart_log)
+    {
+        fputc(data, uart_log);
+    }
+}
+
+static bool led_bus_start(void *context, uint8_t address)
+{
+    (void)context;
+    if (address != LED_BAR_ADDRESS && address != GENERAL_CALL)
+    {
+        led_bus.nacked++;
+        return false;
+    }
+    bus_start(&led_bus);
+    return true;
+}
+
+static void led_bus_byte(void *context, uint8_t data)
+{
+    (void)context;
+    (void)data;
+    led_bus.frame_bytes++;
+}
+
+static void led_bus_stop(void *context)
+{
+    (void)context;
+    if (led_bus.frame_bytes != 2)   // Address and the bar state
+    {
+        led_stray_frames++;
+    }
+    bus_stop(&led_bus);
+}
+
+static const struct hal_sim_i2c_device lcd_device = {lcd_bus_start, lcd_bus_byte, lcd_bus_stop, NULL};
+static const struct hal_sim_i2c_device led_device = {led_bus_start, led_bus_byte, led_bus_stop, NULL};
+
+//---------------- Stepping ----------------
+
+static void poll(struct node *node)
+{
+    // The main loop takes no simulated time, so give a node that stays awake a few passes per tick.
+    int passes;
+    for (passes = 0; passes < MAX_POLLS_PER_TICK && !node->sleeping(); passes++)
+    {
+        node->app_poll();
+    }
+}
+
+static void run(uint32_t ticks)
+{
+    while (ticks--)
+    {
+        poll(&controller);
+        poll(&lcd);
+        controller.step();
+        lcd.step();
+        now++;
+        hd44780_settle();
+    }
+}
+
+static bool press(char key)
+{
+    int row, column;
+    for (row = 0; row < 4; row++)
+    {
+        for (column = 0; column < 4; column++)
+        {
+            if (key_map[row][column] == key)
+            {
+                pressed_row = row;
+                pressed_column = column;
+                key_pressed_at = now;
+                run(TICKS_MS(KEY_HOLD_MS));
+                pressed_row = -1;
+                run(TICKS_MS(KEY_GAP_MS));
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//---------------- Script ----------------
+
+static void run_script(FILE *script)
+{
+    char line[128];
+    int number = 0;
+    while (fgets(line, sizeof(line), script))
+    {
+        number++;
+        char command[16];
+        char argument[96] = "";
+        if (sscanf(line, " %15s %95s", command, argument) < 1 || command[0] == '#')
+        {
+            continue;
+        }
+
+        if (strcmp(command, "key") == 0)
+        {
+            const char *key;
+            for (key = argument; *key; key++)
+            {
+                if (!press(*key))
+                {
+                    fprintf(stderr, "line %d: no key '%c'\n", number, *key);
+                }
+            }
+        }
+        else if (strcmp(command, "temp") == 0)
+        {
+            controller.adc_set_input(1, lm19_code(atof(argument)));
+            temp_changed_at = now ? now : 1;
+        }
+        else if (strcmp(command, "wait") == 0)
+        {
+            run(TICKS_MS(atof(argument)));
+        }
+        else if (strcmp(command, "screen") == 0)
+        {
+            print_screen();
+        }
+        else if (strcmp(command, "host") == 0)
+        {
+            if (host_log)
+            {
+                fclose(host_log);
+            }
+            if (!(host_log = fopen(argument, "w")))
+            {
+                perror(argument);
+            }
+        }
+        else if (strcmp(command, "uart") == 0)
+        {
+            if (uart_log)
+            {
+                fclose(uart_log);
+            }
+            if (!(uart_log = fopen(argument, "wb")))
+            {
+                perror(argument);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "line %d: unknown command %s\n", number, command);
+        }
+    }
+}
+
+//---------------- Report ----------------
+
+static void print_latency(const char *name, const struct latency *latency)
+{
+    if (latency->count == 0)
+    {
+        printf("%-24s no samples\n", name);
+        return;
+    }
+    printf("%-24s %u samples, min %.2f ms, mean %.2f ms, max %.2f ms\n", name, latency->count,
+           latency->min * 1000.0 / TICKS_PER_SECOND,
+           latency->total * 1000.0 / TICKS_PER_SECOND / latency->count,
+           latency->max * 1000.0 / TICKS_PER_SECOND);
+}
+
+static void print_bus(const char *name, const struct bus_stats *bus, double seconds)
+{
+    printf("%-24s %u frames, %.2f frames/s, %u bytes, %.2f bytes/frame (max %u), %u NACKed\n", name,
+           bus->frames, bus->frames / seconds, bus->bytes, bus->frames ? (double)bus->bytes / bus->frames : 0.0,
+           bus->max_bytes, bus->nacked);
+}
+
+static void print_tasks(struct node *node, const char *name)
+{
+    // Tasks are numbered as in the node's enum task, highest priority first.
+    const struct scheduler *scheduler = symbol(node, "scheduler");
+    int i;
+    for (i = 0; i < scheduler->count; i++)
+    {
+        const struct scheduler_task *task = &scheduler->tasks[i];
+        char label[32];
+        snprintf(label, sizeof(label), "%s task %d", name, i);
+        printf("%-24s %u runs, worst %.2f ms, deadline %.2f ms, %u missed\n", label, task->runs,
+               task->worst_latency * 1000.0 / TICKS_PER_SECOND, task->deadline * 1000.0 / TICKS_PER_SECOND,
+               task->misses);
+    }
+}
+
+static void print_boot(struct node *node, const char *name, const char *event)
+{
+    // boot_ticks is the node's own uptime at the event; both nodes start at t = 0.
+    const uint32_t *ticks = symbol(node, "boot_ticks");
+    if (*ticks == 0)
+    {
+        printf("%-24s never %s\n", name, event);
+        return;
+    }
+    printf("%-24s %s after %.2f ms\n", name, event, *ticks * 1000.0 / TICKS_PER_SECOND);
+}
+
+static void print_power(struct node *node, const char *name)
+{
+    const struct power_stats *stats = symbol(node, "power_stats");
+    uint16_t (*active_permille)(const struct power_stats *stats);
+    *(void **)&active_permille = symbol(node, "power_stats_active_permille");
+
+    uint16_t permille = active_permille(stats);
+    printf("%-24s %u.%u %% active, %u wakeups\n", name, permille / 10, permille % 10, stats->wakeups);
+}
+
+// The LED bar only ever takes pattern frames; anything else on its bus is a routing bug.
+static bool led_bar_ok(void)
+{
+    bool ok = led_bus.nacked == 0 && led_stray_frames == 0;
+    printf("%-24s %u frames that weren't one pattern byte, %u NACKed: %s\n", "LED bar check", led_stray_frames,
+           led_bus.nacked, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void report(void)
+{
+    double seconds = now / (double)TICKS_PER_SECOND;
+    printf("\nsimulated %.3f s\n", seconds);
+    print_bus("LCD bus", &lcd_bus, seconds);
+    print_bus("LED bus", &led_bus, seconds);
+    printf("%-24s %u updates, %.2f updates/s, %u HD44780 writes, %.2f writes/update\n", "display",
+           hd44780.updates, hd44780.updates / seconds, hd44780.writes,
+           hd44780.updates ? (double)hd44780.writes / hd44780.updates : 0.0);
+    print_latency("key to display", &key_latency);
+    print_latency("temperature to display", &temp_latency);
+    if (uart_bytes)
+    {
+        printf("%-24s %u bytes, %.2f bytes/s\n", "telemetry UART", uart_bytes, uart_bytes / seconds);
+    }
+    print_boot(&controller, "controller boot", "status acknowledged");
+    print_boot(&lcd, *(const bool *)symbol(&lcd, "warm_boot") ? "lcd warm boot" : "lcd cold boot", "screen up");
+    print_power(&controller, "controller CPU");
+    print_power(&lcd, "lcd CPU");
+    print_tasks(&controller, "controller");
+    print_tasks(&lcd, "lcd");
+}
+
+int main(int argc, char **argv)
+{
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-v") == 0)
+    {
+        verbose = true;
+        arg++;
+    }
+    if (argc - arg > 3)
+    {
+        fprintf(stderr, "usage: %s [-v] [controller.so lcd.so] [script]\n", argv[0]);
+        return 2;
+    }
+    if (argc - arg >= 2)  // A lone argument is the script
+    {
+        controller.path = argv[arg++];
+        lcd.path = argv[arg++];
+    }
+    FILE *script = stdin;
+    if (arg < argc && !(script = fopen(argv[arg], "r")))
+    {
+        perror(argv[arg]);
+        return 1;
+    }
+
+    load(&controller);
+    load(&lcd);
+
+    keypad_out = symbol(&controller, "P3OUT");
+    keypad_in = symbol(&controller, "P3IN");
+    controller.set_step_hook(keypad_step);
+    controller.i2c_attach(LCD_BUS, &lcd_device);
+    controller.i2c_attach(LED_BUS, &led_device);
+    controller.adc_set_input(1, lm19_code(25.0));
+    controller.uart_set_tx_hook(uart_byte);
+
+    // Both buses are pulled up and no slave ever holds a line, so SDA and SCL read high.
+    *(volatile uint8_t *)symbol(&controller, "P1IN") |= BIT2 | BIT3;
+    *(volatile uint8_t *)symbol(&controller, "P4IN") |= BIT6 | BIT7;
+
+    lcd_port = symbol(&lcd, "P1OUT");
+    lcd.set_delay_hook(hd44780_strobe);
+    memset(hd44780.ddram, ' ', sizeof(hd44780.ddram));
+    hd44780_line(0, hd44780.shown[0]);
+    hd44780_line(1, hd44780.shown[1]);
+
+    controller.app_init();
+    lcd.app_init();
+
+    run_script(script);
+    report();
+    bool ok = led_bar_ok();
+    if (host_log)
+    {
+        fclose(host_log);
+    }
+    if (uart_log)
+    {
+        fclose(uart_log);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @brief Host test for the LED bar pattern engine.
+ *
+ * Runs the engine on the simulated TB1 timer wheel, the way the controller
+ * does, and steps every pattern through a full period and back to its first
+ * step, comparing each bar state against a table written out by hand and each
+ * step's time against the period. Then checks that a period change keeps the
+ * pattern's place and that LED_PATTERN_NONE stops it with the bar off:
+ *
+ *     gcc -std=c99 -DHAL_SIM -Icommon -Icommon/hal -Icontroller/app sim/test_led_pattern.c \
+ *         controller/app/led_pattern.c controller/app/timer_wheel.c controller/app/uptime.c \
+ *         common/hal/hal_sim.c -o test_led_pattern
+ *     ./test_led_pattern
+ *
+ * Exits non-zero if any check fails.
+ */
+
+#include <stdio.h>
+#include "hal.h"
+#include "led_pattern.h"
+#include "timer_wheel.h"
+#include "uptime.h"
+
+#define PERIOD 4            // Wheel ticks per step
+#define MAX_STEPS 300       // More than the longest pattern
+
+static int failures = 0;
+
+#define CHECK(condition, ...) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint8_t static_expected[] = {0xAA};
+static const uint8_t break_expected[] = {0xAA, 0x55};
+static const uint8_t in_and_out_expected[] = {0x18, 0x24, 0x42, 0x81, 0x42, 0x24};
+static const uint8_t rotate_1_expected[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+static const uint8_t rotate_7_expected[] = {0xFE, 0xFD, 0xFB, 0xF7, 0xEF, 0xDF, 0xBF, 0x7F};
+static const uint8_t fill_expected[] = {0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF};
+static uint8_t up_counter_expected[256];     // 0x00 ... 0xFF, filled in by main()
+static uint8_t down_counter_expected[256];   // 0xFF ... 0x00
+
+/**
+ * What one pattern should show, step by step.
+ */
+struct expected
+{
+    const char *name;
+    const uint8_t *frames;
+    uint16_t length;
+};
+
+#define EXPECTED(name, frames) {name, frames, sizeof(frames)}
+
+static const struct expected patterns[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_STATIC] = EXPECTED("static", static_expected),
+    [LED_PATTERN_BREAK] = EXPECTED("break", break_expected),
+    [LED_PATTERN_UP_COUNTER] = EXPECTED("up counter", up_counter_expected),
+    [LED_PATTERN_IN_AND_OUT] = EXPECTED("in and out", in_and_out_expected),
+    [LED_PATTERN_DOWN_COUNTER] = EXPECTED("down counter", down_counter_expected),
+    [LED_PATTERN_ROTATE_1_LEFT] = EXPECTED("rotate 1 left", rotate_1_expected),
+    [LED_PATTERN_ROTATE_7_LEFT] = EXPECTED("rotate 7 left", rotate_7_expected),
+    [LED_PATTERN_FILL_LEFT] = EXPECTED("fill left", fill_expected),
+};
+
+// Every step the engine takes, as the controller's led_timer_expired() would see it.
+static uint8_t step_frames[MAX_STEPS];
+static uint32_t step_ticks[MAX_STEPS];
+static int steps = 0;
+
+static bool led_timer_expired(void)
+{
+    led_pattern_step();
+    if (steps < MAX_STEPS)
+    {
+        step_frames[steps] = led_pattern_frame();
+        step_ticks[steps] = hal_sim_ticks();
+        steps++;
+    }
+    return false;
+}
+
+static struct soft_timer led_timer = SOFT_TIMER(led_timer_expired);
+
+HAL_ISR(TIMER1_B0_VECTOR, timer_wheel_tick)
+{
+    timer_wheel_isr();
+}
+
+HAL_ISR(TIMER1_B1_VECTOR, uptime_overflow)
+{
+    if (TB1IV == 0x0E)
+    {
+        uptime_overflows++;
+    }
+}
+
+// Run the simulator until the engine has taken count more steps, or twice as long as that should take.
+static void run_steps(int count, uint16_t period)
+{
+    int target = steps + count;
+    uint32_t limit = 2UL * count * ((uint32_t)period << TIMER_WHEEL_SHIFT);
+    while (steps < target && limit--)
+    {
+        hal_sim_step();
+    }
+}
+
+static void test_pattern(uint8_t pattern)
+{
+    const struct expected *expected = &patterns[pattern];
+
+    led_pattern_select(pattern);
+    CHECK(led_pattern_frame() == expected->frames[0], "%s starts at 0x%02X, want 0x%02X", expected->name,
+          led_pattern_frame(), expected->frames[0]);
+
+    // A full period, ending back on the first step.
+    steps = 0;
+    uint32_t selected_at = hal_sim_ticks();
+    run_steps(expected->length, PERIOD);
+    CHECK(steps == expected->length, "%s took %d of %u steps", expected->name, steps, expected->length);
+
+    int i;
+    for (i = 0; i < steps; i++)
+    {
+        uint8_t want = expected->frames[(i + 1) % expected->length];
+        CHECK(step_frames[i] == want, "%s step %d is 0x%02X, want 0x%02X", expected->name, i + 1, step_frames[i],
+              want);
+
+        uint32_t previous = i ? step_ticks[i - 1] : selected_at;
+        uint32_t interval = step_ticks[i] - previous;
+        if (i)  // The first step is measured from a wheel tick, not from the select
+        {
+            CHECK(interval == PERIOD << TIMER_WHEEL_SHIFT, "%s step %d after %lu ticks, want %u", expected->name,
+                  i + 1, (unsigned long)interval, PERIOD << TIMER_WHEEL_SHIFT);
+        }
+    }
+}
+
+static void test_period_change(void)
+{
+    led_pattern_select(LED_PATTERN_ROTATE_1_LEFT);
+    steps = 0;
+    run_steps(3, PERIOD);
+
+    // Twice as slow from the step after next. The pattern carries on from 0x08 rather than starting again.
+    led_pattern_set_period(2 * PERIOD);
+    run_steps(3, 2 * PERIOD);
+    CHECK(steps == 6, "%d of 6 steps around the period change", steps);
+
+    int i;
+    for (i = 0; i < steps; i++)
+    {
+        CHECK(step_frames[i] == rotate_1_expected[i + 1], "step %d after the period change is 0x%02X, want 0x%02X",
+              i + 1, step_frames[i], rotate_1_expected[i + 1]);
+    }
+
+    uint32_t old_interval = step_ticks[3] - step_ticks[2];
+    uint32_t new_interval = step_ticks[5] - step_ticks[4];
+    CHECK(old_interval == PERIOD << TIMER_WHEEL_SHIFT, "step already scheduled moved to %lu ticks",
+          (unsigned long)old_interval);
+    CHECK(new_interval == 2 * PERIOD << TIMER_WHEEL_SHIFT, "new period gives %lu ticks, want %u",
+          (unsigned long)new_interval, 2 * PERIOD << TIMER_WHEEL_SHIFT);
+
+    led_pattern_set_period(PERIOD);
+}
+
+static void test_none(void)
+{
+    led_pattern_select(LED_PATTERN_FILL_LEFT);
+    led_pattern_select(LED_PATTERN_NONE);
+    CHECK(led_pattern_frame() == 0, "bar is 0x%02X with no pattern", led_pattern_frame());
+
+    steps = 0;
+    run_steps(4, PERIOD);
+    CHECK(steps == 0, "%d steps with no pattern", steps);
+}
+
+int main(void)
+{
+    int i;
+    for (i = 0; i < 256; i++)
+    {
+        up_counter_expected[i] = i;
+        down_counter_expected[i] = 255 - i;
+    }
+
+    uptime_init();
+    timer_wheel_init();
+    led_pattern_init(&led_timer);
+    led_pattern_set_period(PERIOD);
+    __enable_interrupt();
+
+    uint8_t pattern;
+    for (pattern = 0; pattern < LED_PATTERN_COUNT; pattern++)
+    {
+        test_pattern(pattern);
+    }
+    test_period_change();
+    test_none();
+
+    printf("%s, %d failure%s\n", failures ? "FAILED" : "passed", failures, failures == 1 ? "" : "s");
+    return failures != 0;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file
+ * @brief Host test and throughput benchmark for the status frame protocol.
+ *
+ * Checks the CRC-8 against its standard check value and a bitwise reference,
+ * round-trips delta and keyframes against random baselines, and makes sure
+ * corrupted, truncated, wrong-version and unknown-field frames are rejected
+ * without touching the receiver's fields. Then times encode plus decode:
+ *
+ *     gcc -std=c99 -O2 -Icommon sim/test_status_frame.c common/status_frame.c -o test_status_frame
+ *     ./test_status_frame
+ *
+ * Exits non-zero if any check fails.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "status_frame.h"
+
+#define ROUND_TRIPS 10000
+#define BENCHMARK_FRAMES 2000000UL
+
+static int failures = 0;
+
+#define CHECK(condition, ...) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+// Polynomial 0x07 a bit at a time, to check the nibble table against.
+static uint8_t reference_crc8(const uint8_t *data, uint8_t length)
+{
+    uint8_t crc = 0;
+    while (length--)
+    {
+        crc ^= *data++;
+        int bit;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void random_fields(uint8_t *fields)
+{
+    int i;
+    for (i = 0; i < STATUS_FIELD_COUNT; i++)
+    {
+        fields[i] = rand() & 0xFF;
+    }
+}
+
+static void test_crc(void)
+{
+    const uint8_t check[] = "123456789";
+    CHECK(status_frame_crc8(check, 9) == 0xF4, "CRC-8 check value 0x%02X, want 0xF4", status_frame_crc8(check, 9));
+    CHECK(status_frame_crc8(check, 0) == 0x00, "CRC-8 of nothing isn't 0");
+
+    uint8_t data[STATUS_FRAME_MAX_LENGTH];
+    int i;
+    for (i = 0; i < ROUND_TRIPS; i++)
+    {
+        uint8_t length = rand() % (sizeof(data) + 1);
+        int j;
+        for (j = 0; j < length; j++)
+        {
+            data[j] = rand() & 0xFF;
+        }
+        CHECK(status_frame_crc8(data, length) == reference_crc8(data, length), "CRC-8 differs from the reference");
+    }
+}
+
+static void test_round_trip(void)
+{
+    uint8_t fields[STATUS_FIELD_COUNT];
+    uint8_t baseline[STATUS_FIELD_COUNT];
+    uint8_t received[STATUS_FIELD_COUNT];
+    uint8_t frame[STATUS_FRAME_MAX_LENGTH];
+
+    int i;
+    for (i = 0; i < ROUND_TRIPS; i++)
+    {
+        random_fields(baseline);
+        memcpy(fields, baseline, sizeof(fields));
+
+        // Change a random subset, so every mask comes up.
+        uint8_t changes = rand() & ((1 << STATUS_FIELD_COUNT) - 1);
+        int changed = 0;
+        int field;
+        for (field = 0; field < STATUS_FIELD_COUNT; field++)
+        {
+            if (changes & (1 << field))
+            {
+                fields[field] = baseline[field] + 1 + rand() % 255;
+                changed++;
+            }
+        }
+
+        bool keyframe = (rand() & 7) == 0;
+        uint8_t length = status_frame_encode(frame, fields, baseline, keyframe);
+        if (keyframe)
+        {
+            CHECK(length == STATUS_FRAME_MAX_LENGTH, "keyframe is %u bytes", length);
+            CHECK(frame[0] & STATUS_FRAME_KEYFRAME, "keyframe flag not set");
+        }
+        else if (changed == 0)
+        {
+            CHECK(length == 0, "nothing changed but a %u byte frame was built", length);
+            continue;
+        }
+        else
+        {
+            CHECK(length == STATUS_FRAME_OVERHEAD + changed, "%d fields changed, frame is %u bytes", changed, length);
+        }
+
+        // The receiver holds the baseline, so a delta frame brings it up to date.
+        memcpy(received, baseline, sizeof(received));
+        CHECK(status_frame_decode(received, frame, length), "valid frame rejected");
+        CHECK(memcmp(received, fields, sizeof(fields)) == 0, "decoded fields differ");
+    }
+}
+
+static void test_rejection(void)
+{
+    uint8_t fields[STATUS_FIELD_COUNT];
+    uint8_t baseline[STATUS_FIELD_COUNT] = {0};
+    uint8_t received[STATUS_FIELD_COUNT];
+    uint8_t untouched[STATUS_FIELD_COUNT];
+    uint8_t frame[STATUS_FRAME_MAX_LENGTH + 1];
+
+    int i;
+    for (i = 0; i < ROUND_TRIPS / 10; i++)
+    {
+        random_fields(fields);
+        random_fields(untouched);
+        uint8_t length = status_frame_encode(frame, fields, baseline, (i & 1) != 0);
+        if (length == 0)
+        {
+            continue;
+        }
+
+        // CRC-8 catches every single bit error.
+        int bit;
+        for (bit = 0; bit < length * 8; bit++)
+        {
+            frame[bit / 8] ^= 1 << (bit % 8);
+            memcpy(received, untouched, sizeof(received));
+            CHECK(!status_frame_decode(received, frame, length), "bit %d flipped, frame accepted", bit);
+            CHECK(memcmp(received, untouched, sizeof(received)) == 0, "rejected frame changed the fields");
+            frame[bit / 8] ^= 1 << (bit % 8);
+        }
+
+        // A torn frame, cut short or run into the next one's bytes.
+        uint8_t cut;
+        for (cut = 0; cut < length; cut++)
+        {
+            memcpy(received, untouched, sizeof(received));
+            CHECK(!status_frame_decode(received, frame, cut), "frame cut to %u of %u bytes accepted", cut, length);
+            CHECK(memcmp(received, untouched, sizeof(received)) == 0, "rejected frame changed the fields");
+        }
+        frame[length] = rand() & 0xFF;
+        CHECK(!status_frame_decode(received, frame, length + 1), "frame with a stray byte accepted");
+    }
+
+    // Right CRC, but a version or field this receiver doesn't know.
+    uint8_t other_version[] = {(STATUS_FRAME_VERSION + 1) << 4, 0x01, 3, 0};
+    other_version[3] = status_frame_crc8(other_version, 3);
+    CHECK(!status_frame_decode(received, other_version, sizeof(other_version)), "other version accepted");
+
+    uint8_t unknown_field[] = {STATUS_FRAME_VERSION << 4, 1 << STATUS_FIELD_COUNT, 3, 0};
+    unknown_field[3] = status_frame_crc8(unknown_field, 3);
+    CHECK(!status_frame_decode(received, unknown_field, sizeof(unknown_field)), "unknown field accepted");
+}
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void benchmark(void)
+{
+    // The controller's traffic: mostly one or two changed fields, every field now and then.
+    static uint8_t states[256][STATUS_FIELD_COUNT];
+    int i;
+    for (i = 0; i < 256; i++)
+    {
+        random_fields(states[i]);
+        if (i > 0 && (i & 15) != 0)
+        {
+            memcpy(states[i], states[i - 1], STATUS_FIELD_COUNT);
+            states[i][rand() % STATUS_FIELD_COUNT]++;
+        }
+    }
+
+    uint8_t frame[STATUS_FRAME_MAX_LENGTH];
+    uint8_t received[STATUS_FIELD_COUNT] = {0};
+    unsigned long bytes = 0;
+    unsigned long accepted = 0;
+
+    double start = seconds_now();
+    unsigned long n;
+    for (n = 0; n < BENCHMARK_FRAMES; n++)
+    {
+        const uint8_t *fields = states[n & 255];
+        const uint8_t *baseline = states[(n - 1) & 255];
+        uint8_t length = status_frame_encode(frame, fields, baseline, (n & 255) == 0);
+        bytes += length;
+        accepted += status_frame_decode(received, frame, length);
+    }
+    double elapsed = seconds_now() - start;
+
+    CHECK(accepted == BENCHMARK_FRAMES, "%lu of %lu benchmark frames decoded", accepted, BENCHMARK_FRAMES);
+    printf("encode + decode          %lu frames in %.3f s, %.0f frames/s, %.2f bytes/frame\n",
+           BENCHMARK_FRAMES, elapsed, BENCHMARK_FRAMES / elapsed, (double)bytes / BENCHMARK_FRAMES);
+}
+
+int main(void)
+{
+    srand(1);
+
+    test_crc();
+    test_round_trip();
+    test_rejection();
+    benchmark();
+
+    printf("%s, %d failure%s\n", failures ? "FAILED" : "passed", failures, failures == 1 ? "" : "s");
+    return failures != 0;
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Decode the controller's UART telemetry stream into CSV.
+
+Build the controller with the TELEMETRY predefined symbol and it streams raw
+ADC conversions, filtered readings and state changes on the LaunchPad's
+backchannel UART, see controller/app/telemetry.h. Read the serial port
+directly, or a capture of it:
+
+    python3 tools/decode_telemetry.py /dev/ttyACM1 > samples.csv
+    python3 tools/decode_telemetry.py capture.bin > samples.csv
+
+A serial port is set to raw 8N1 at --baud first. The default, 57600, matches
+the default 1 MHz clock profile; pass --baud 115200 for every other profile,
+see CLOCK_UART_BAUD in common/clock.h. Prints one CSV row per record:
+seconds since the controller booted (of the frame the record came in), frame
+sequence number, record type, channel, and the values. Dropped frames, whether
+lost on the controller or corrupted on the wire, are counted from sequence
+gaps and reported on stderr at the end, or on Ctrl-C.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import termios
+
+FRAME_SYNC = 0x7E
+HEADER = struct.Struct("<BBBI")     # sync, sequence, length, time
+DATA_MAX = 64
+TICKS_PER_SECOND = 32768
+
+SAMPLE = 0x1
+FILTERED = 0x2
+STATE = 0x3
+RECORD_LENGTHS = {SAMPLE: 3, FILTERED: 5, STATE: 2}
+
+STATES = ["locked", "unlocking", "unlocked", "set_window", "set_pattern"]
+
+BAUD_RATES = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400, 57600: termios.B57600,
+              115200: termios.B115200}
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def open_input(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        attributes = termios.tcgetattr(fd)
+        attributes[0] = 0                                                   # iflag: no translation
+        attributes[1] = 0                                                   # oflag
+        attributes[2] = termios.CS8 | termios.CREAD | termios.CLOCAL        # cflag: 8N1
+        attributes[3] = 0                                                   # lflag: raw
+        attributes[4] = attributes[5] = BAUD_RATES[baud]
+        attributes[6][termios.VMIN] = 1
+        attributes[6][termios.VTIME] = 0
+        termios.tcsetattr(fd, termios.TCSANOW, attributes)
+        termios.tcflush(fd, termios.TCIFLUSH)
+    return os.fdopen(fd, "rb", buffering=0)
+
+
+class Decoder:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.expected = None    # Next sequence number, None until the first frame
+        self.frames = 0
+        self.dropped = 0
+        self.skipped = 0        # Bytes thrown away while looking for a frame
+
+    def feed(self, data):
+        """Yield each valid frame in data, plus whatever was left over from the last call."""
+        self.buffer += data
+        while True:
+            start = self.buffer.find(FRAME_SYNC)
+            if start < 0:
+                self.skipped += len(self.buffer)
+                self.buffer.clear()
+                return
+            if start:
+                self.skipped += start
+                del self.buffer[:start]
+            if len(self.buffer) < HEADER.size:
+                return
+
+            _, sequence, length, time = HEADER.unpack_from(self.buffer)
+            end = HEADER.size + length + 1
+            if length > DATA_MAX:
+                self.skip_sync()
+                continue
+            if len(self.buffer) < end:
+                return
+            if crc8(self.buffer[:end - 1]) != self.buffer[end - 1]:
+                self.skip_sync()    # A 0x7E inside a frame, or a damaged one; look again one byte on
+                continue
+
+            records = bytes(self.buffer[HEADER.size:end - 1])
+            del self.buffer[:end]
+            self.count(sequence)
+            yield sequence, time, records
+
+    def skip_sync(self):
+        self.skipped += 1
+        del self.buffer[:1]
+
+    def count(self, sequence):
+        if self.expected is not None:
+            self.dropped += (sequence - self.expected) & 0xFF
+        self.expected = (sequence + 1) & 0xFF
+        self.frames += 1
+
+
+def rows(sequence, time, records):
+    seconds = f"{time / TICKS_PER_SECOND:.5f}"
+    i = 0
+    while i < len(records):
+        kind, channel = records[i] >> 4, records[i] & 0x0F
+        length = RECORD_LENGTHS.get(kind)
+        if length is None or i + length > len(records):
+            print(f"frame {sequence}: bad record tag 0x{records[i]:02x}", file=sys.stderr)
+            return
+        if kind == SAMPLE:
+            code, = struct.unpack_from("<H", records, i + 1)
+            yield seconds, sequence, "sample", channel, code, ""
+        elif kind == FILTERED:
+            code, reading = struct.unpack_from("<Hh", records, i + 1)
+            yield seconds, sequence, "filtered", channel, code, reading
+        else:
+            state = records[i + 1]
+            yield seconds, sequence, "state", "", state, STATES[state] if state < len(STATES) else ""
+        i += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial port, or a file holding the raw UART bytes")
+    parser.add_argument("--baud", type=int, default=57600, choices=sorted(BAUD_RATES),
+                        help="rate to set a serial port to (default 57600, the 1 MHz clock profile)")
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    print("seconds,frame,record,channel,value,extra")
+    try:
+        with open_input(args.input, args.baud) as source:
+            while True:
+                data = source.read(4096)
+                if not data:
+                    break
+                for frame in decoder.feed(data):
+                    for row in rows(*frame):
+                        print(",".join(str(field) for field in row))
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+    print(f"{decoder.frames} frames, {decoder.dropped} dropped, {decoder.skipped} bytes skipped", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode a temperature log readout from the controller.
+
+Pressing # while unlocked streams the log to the I2C host address as frames,
+see controller/app/temperature_log.h. Save what the bus adapter received as
+one frame per line in hex and decode it:
+
+    python3 tools/decode_temperature_log.py frames.txt > history.csv
+
+or pass --image for the readout bytes already put back together. Prints one
+CSV row per sample: sequence number, degrees Celsius, and "boot" on the first
+sample after a controller reset.
+"""
+
+import argparse
+import struct
+import sys
+
+FRAME_HEADER = 0xE1
+BLOCK_SIZE = 64
+BLOCK_HEADER = struct.Struct("<IhBB")   # start, first, used, flags
+ESCAPE = 0x80
+BOOT = 0x01
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def image_from_frames(lines):
+    image = bytearray()
+    for number, line in enumerate(lines, 1):
+        frame = bytes.fromhex(line.replace(",", " "))
+        if not frame:
+            continue
+        if frame[0] != FRAME_HEADER or len(frame) < 4 or crc8(frame[:-1]) != frame[-1]:
+            sys.exit(f"line {number}: not a valid log frame")
+        offset = frame[1] | frame[2] << 8
+        data = frame[3:-1]
+        if not data:
+            return image
+        if offset > len(image):
+            sys.exit(f"line {number}: gap before offset {offset}, frames are missing")
+        image[offset:offset + len(data)] = data
+    sys.exit("no end frame, the readout is incomplete")
+
+
+def samples(image):
+    for base in range(0, len(image) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        start, value, used, flags = BLOCK_HEADER.unpack_from(image, base)
+        data = image[base + BLOCK_HEADER.size:base + BLOCK_HEADER.size + used]
+        sequence = start
+        yield sequence, value, bool(flags & BOOT)
+
+        i = 0
+        while i < len(data):
+            if data[i] == ESCAPE:
+                value = struct.unpack_from("<h", data, i + 1)[0]
+                i += 3
+            else:
+                value += struct.unpack_from("<b", data, i)[0]
+                i += 1
+            sequence += 1
+            yield sequence, value, False
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="readout frames in hex, one per line, or the raw image with --image")
+    parser.add_argument("--image", action="store_true", help="input is the readout bytes, not frames")
+    args = parser.parse_args()
+
+    if args.image:
+        with open(args.input, "rb") as source:
+            image = source.read()
+    else:
+        with open(args.input) as source:
+            image = image_from_frames(source)
+
+    print("sample,celsius,event")
+    for sequence, value, boot in samples(image):
+        print(f"{sequence},{value / 10:.1f},{'boot' if boot else ''}")
+
+
+if __name__ == "__main__":
+    main()
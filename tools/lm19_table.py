@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Generate the LM19 lookup table used by controller/app/temperature.c.
+
+Prints the table as a C initializer, then checks the integer interpolation
+used on the MSP430 against the floating point LM19 formula for every
+oversampled ADC code and reports the worst case error.
+"""
+
+import math
+
+REF_VOLTAGE = 3.3
+OVERSAMPLE_SHIFT = 2                           # 16x oversampling decimated to 12 + 2 bits
+ADC_MAX_CODE = 4095 << OVERSAMPLE_SHIFT
+TABLE_SHIFT = 7 + OVERSAMPLE_SHIFT
+TABLE_STEP = 1 << TABLE_SHIFT
+TABLE_ENTRIES = (ADC_MAX_CODE >> TABLE_SHIFT) + 2
+
+
+def lm19_celsius(code):
+    voltage = code / ADC_MAX_CODE * REF_VOLTAGE
+    return -1481.96 + math.sqrt(2.1962e6 + (1.8639 - voltage) / 3.88e-6)
+
+
+def interpolate(table, code):
+    # Mirrors temperature_from_adc() exactly, including rounding.
+    index = code >> TABLE_SHIFT
+    fraction = code & (TABLE_STEP - 1)
+    drop = table[index] - table[index + 1]
+    return table[index] - ((drop * fraction + TABLE_STEP // 2) >> TABLE_SHIFT)
+
+
+def main():
+    table = [round(lm19_celsius(i * TABLE_STEP) * 10) for i in range(TABLE_ENTRIES)]
+
+    print("static const int16_t lm19_table[] = {")
+    for start in range(0, len(table), 11):
+        row = table[start:start + 11]
+        print("    " + " ".join(f"{value},".ljust(6) for value in row).rstrip())
+    print("};")
+
+    worst_code, worst_error = 0, 0.0
+    for code in range(ADC_MAX_CODE + 1):
+        error = abs(interpolate(table, code) - lm19_celsius(code) * 10)
+        if error > worst_error:
+            worst_code, worst_error = code, error
+
+    print(f"\n// max error {worst_error / 10:.3f} C at ADC code {worst_code}")
+
+
+if __name__ == "__main__":
+    main()
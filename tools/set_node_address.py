@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Set the I2C address of one LCD unit in a built firmware image.
+
+The LCD reads its address from the byte at NODE_ADDRESS_LOCATION in info FRAM
+(lcd/app/node_address.h). This rewrites that byte in a TI-TXT image, so one
+build can be flashed to every unit with a different address each:
+
+    python3 tools/set_node_address.py lcd.txt 0x02 -o lcd_0x02.txt
+"""
+
+import argparse
+
+NODE_ADDRESS_LOCATION = 0x1800
+
+
+def read_ti_txt(path):
+    memory = {}
+    address = None
+    with open(path) as image:
+        for line in image:
+            line = line.strip()
+            if not line or line == "q":
+                continue
+            if line.startswith("@"):
+                address = int(line[1:], 16)
+                continue
+            for byte in line.split():
+                memory[address] = int(byte, 16)
+                address += 1
+    return memory
+
+
+def write_ti_txt(path, memory):
+    with open(path, "w") as image:
+        previous = None
+        row = []
+        for address in sorted(memory):
+            if previous is None or address != previous + 1:
+                if row:
+                    image.write(" ".join(row) + "\n")
+                    row = []
+                image.write(f"@{address:04X}\n")
+            row.append(f"{memory[address]:02X}")
+            if len(row) == 16:
+                image.write(" ".join(row) + "\n")
+                row = []
+            previous = address
+        if row:
+            image.write(" ".join(row) + "\n")
+        image.write("q\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="TI-TXT image of the LCD firmware")
+    parser.add_argument("address", type=lambda text: int(text, 0), help="7-bit address, 0x01 - 0x7F")
+    parser.add_argument("-o", "--output", help="output image, defaults to rewriting the input")
+    args = parser.parse_args()
+
+    if not 0x01 <= args.address <= 0x7F:
+        parser.error("address must be 0x01 - 0x7F; 0x00 is general call")
+
+    memory = read_ti_txt(args.image)
+    if NODE_ADDRESS_LOCATION not in memory:
+        parser.error(f"image has nothing at 0x{NODE_ADDRESS_LOCATION:04X}, was it built with node_address.c?")
+
+    memory[NODE_ADDRESS_LOCATION] = args.address
+    write_ti_txt(args.output or args.image, memory)
+    print(f"0x{NODE_ADDRESS_LOCATION:04X} = 0x{args.address:02X}")
+
+
+if __name__ == "__main__":
+    main()